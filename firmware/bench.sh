@@ -0,0 +1,7 @@
+# press-to-server latency gate on the host build, usage: ./bench.sh [presses] [p99 budget in us]
+PRESSES=${1:-2000}
+BUDGET=${2:-20000}
+
+./build-linux.sh
+
+(sleep 2; echo "bench $PRESSES $BUDGET") | ./build-linux/doorbell-firmware.elf
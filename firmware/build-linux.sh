@@ -0,0 +1,5 @@
+mkdir -p build-linux
+
+cmake -B build-linux/ -DIDF_TARGET=linux -DSDKCONFIG=build-linux/sdkconfig -DSDKCONFIG_DEFAULTS=sdkconfig.defaults.linux .
+
+make -C build-linux/
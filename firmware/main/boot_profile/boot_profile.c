@@ -0,0 +1,68 @@
+#include "boot_profile.h"
+
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "boot profile";
+
+struct BootPhaseRecord {
+    int64_t begin_time;
+    int64_t end_time;
+    const char *task;
+};
+
+static struct BootPhaseRecord boot_phases[BootPhase_Count];
+
+static const char *boot_phase_names[BootPhase_Count] = {
+    [BootPhase_Trace] = "trace",
+    [BootPhase_Sleep] = "sleep service",
+    [BootPhase_Doorbell] = "doorbell",
+    [BootPhase_Status] = "status",
+    [BootPhase_Nvs] = "nvs",
+    [BootPhase_EventLoop] = "event loop",
+    [BootPhase_WifiDriver] = "wifi driver",
+    [BootPhase_WifiConfig] = "wifi handlers and config",
+    [BootPhase_WifiStart] = "wifi start",
+};
+
+void boot_phase_begin(enum BootPhase phase)
+{
+    boot_phases[phase].task = pcTaskGetName(NULL);
+    boot_phases[phase].begin_time = esp_timer_get_time();
+}
+
+void boot_phase_end(enum BootPhase phase)
+{
+    boot_phases[phase].end_time = esp_timer_get_time();
+}
+
+void boot_profile_log(int64_t app_main_start_time, int64_t ready_time)
+{
+    ESP_LOGI(
+        TAG, "ready %" PRId64 " ms since esp_timer start, app_main started after %" PRId64 " ms, presses accepted after %" PRId64 " ms",
+        ready_time / 1000, app_main_start_time / 1000, boot_phases[BootPhase_Doorbell].end_time / 1000
+    );
+
+    for (int i = 0; i < BootPhase_Count; i++)
+    {
+        const struct BootPhaseRecord *record = &boot_phases[i];
+
+        // skipped on this boot
+        if (record->task == NULL)
+        {
+            continue;
+        }
+
+        ESP_LOGI(
+            TAG, "  %s: %" PRId64 " - %" PRId64 " ms, took %" PRId64 " us (%s)",
+            boot_phase_names[i], record->begin_time / 1000, record->end_time / 1000,
+            record->end_time - record->begin_time, record->task
+        );
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <stdint.h>
+
+// every init step between reset and system ready, some of them run at the same time on different tasks
+enum BootPhase {
+    BootPhase_Trace = 0,
+    BootPhase_Sleep = 1,
+    BootPhase_Doorbell = 2,
+    BootPhase_Status = 3,
+    BootPhase_Nvs = 4,
+    BootPhase_EventLoop = 5,
+    BootPhase_WifiDriver = 6,
+    BootPhase_WifiConfig = 7,
+    BootPhase_WifiStart = 8,
+    BootPhase_Count = 9,
+};
+
+// each phase is begun and ended by a single task, and only logged once all of them ended
+void boot_phase_begin(enum BootPhase phase);
+void boot_phase_end(enum BootPhase phase);
+
+// logs when every phase ran, how long it took and on which task. times are esp_timer time, which only starts
+// counting after the bootloader and early startup, so they leave out the time from reset to there
+void boot_profile_log(int64_t app_main_start_time, int64_t ready_time);
+
+#endif
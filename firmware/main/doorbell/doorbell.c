@@ -1,19 +1,30 @@
 #include "doorbell.h"
+#include "press_queue.h"
 
-#include "hal/gpio_types.h"
 #include "status/status.h"
 #include "wifi/wifi.h"
 #include "wifi/socket.h"
+#include "latency/latency.h"
+#include "trace/trace.h"
 #include "main.h"
 
 #include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 
 #include "driver/gpio.h"
+#include "driver/rtc_io.h"
 #include "esp_log.h"
 #include "esp_sleep.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_system.h"
+#endif
 
 static const char *TAG = "doorbell";
 
@@ -21,42 +32,307 @@ static TaskHandle_t doorbell_thread_handle;
 
 EventGroupHandle_t doorbell_events;
 
-static bool took_sleep_inhibit;
+// set when the press woke us up, the ring then waits for the socket in case it dropped while we slept
+static volatile bool woke_from_press;
+
+// rtc memory like the press queue's sequence numbers, or every deep sleep wake would look like dropped presses
+static RTC_DATA_ATTR uint32_t expected_sequence;
+
+static esp_timer_handle_t debounce_timer;
+static esp_timer_handle_t long_press_timer;
+
+// whoever sets this (the isr on an edge, or the debounce timer) owns the debounced state below until it's cleared
+static atomic_bool debouncing;
+
+static int stable_level;
+static int64_t last_press_time;
+static int64_t last_release_time;
+static bool last_press_short;
+// the press being held started shortly after a short one, decided on its leading edge and queued on its release
+static bool press_is_double;
+
+static void IRAM_ATTR notify_doorbell_thread(uint32_t bits, bool from_isr)
+{
+    // the isr is installed before the thread exists, start_doorbell notifies it for anything queued in the meantime
+    if (doorbell_thread_handle == NULL)
+    {
+        return;
+    }
+
+    if (from_isr)
+    {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+
+        xTaskNotifyFromISR(doorbell_thread_handle, bits, eSetBits, &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
+    }
+    else
+    {
+        xTaskNotify(doorbell_thread_handle, bits, eSetBits);
+    }
+}
+
+static void IRAM_ATTR handle_pin_change(int level, int64_t time, bool from_isr)
+{
+    stable_level = level;
+
+    if (level)
+    {
+        press_is_double = last_press_short && (time - last_release_time) < DOORBELL_DOUBLE_PRESS_TIME * 1000;
+
+        last_press_time = time;
+
+        esp_timer_stop(long_press_timer);
+        esp_timer_start_once(long_press_timer, DOORBELL_LONG_PRESS_TIME * 1000);
+    }
+    else
+    {
+        last_press_short = (time - last_press_time) < DOORBELL_LONG_PRESS_TIME * 1000;
+        last_release_time = time;
+
+        esp_timer_stop(long_press_timer);
+
+        // a long press was queued by the long press timer while it was still held
+        if (last_press_short)
+        {
+            // stamped with the leading edge, so the ring latency counts the time the button was held
+            press_queue_push(last_press_time, press_is_double ? DoorbellPressType_Double : DoorbellPressType_Short);
+
+            notify_doorbell_thread(DOORBELL_NOTIFY_PRESS, from_isr);
+
+            // a double ends the gesture, a third quick press starts a new one
+            if (press_is_double)
+            {
+                last_press_short = false;
+            }
+        }
+    }
+}
 
 void IRAM_ATTR doorbell_rung_interrupt(void *args)
 {
-    xEventGroupSetBitsFromISR(doorbell_events, DOORBELL_PRESSED, NULL);
+    // edges inside the debounce window are bounce, the timer looks at the pin once it settles
+    if (atomic_exchange(&debouncing, true))
+    {
+        return;
+    }
+
+    int level = gpio_get_level(DOORBELL_PIN);
+
+    // a glitch that's already gone
+    if (level == stable_level)
+    {
+        atomic_store(&debouncing, false);
+        return;
+    }
+
+    // act on the edge right away so debouncing adds nothing to the ring latency
+    handle_pin_change(level, esp_timer_get_time(), true);
+
+    esp_timer_start_once(debounce_timer, DOORBELL_DEBOUNCE_TIME * 1000);
+}
+
+static void debounce_timer_expired_callback(void *args)
+{
+    int level = gpio_get_level(DOORBELL_PIN);
+
+    // the pin moved again while edges were ignored, e.g. a press shorter than the debounce time
+    if (level != stable_level)
+    {
+        handle_pin_change(level, esp_timer_get_time(), false);
+
+        esp_timer_start_once(debounce_timer, DOORBELL_DEBOUNCE_TIME * 1000);
+
+        return;
+    }
+
+    atomic_store(&debouncing, false);
+
+    // an edge between the read above and opening the gate was dropped by the isr, catch it here
+    if (gpio_get_level(DOORBELL_PIN) != stable_level && !atomic_exchange(&debouncing, true))
+    {
+        handle_pin_change(!stable_level, esp_timer_get_time(), false);
+
+        esp_timer_start_once(debounce_timer, DOORBELL_DEBOUNCE_TIME * 1000);
+    }
+}
+
+// runs in the idle task with interrupts off, right after an automatic light sleep ends
+static esp_err_t IRAM_ATTR doorbell_light_sleep_exit_callback(int64_t sleep_time_us, void *arg)
+{
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_EXT1)
+    {
+        return ESP_OK;
+    }
+
+    woke_from_press = true;
+
+    // the edge came in while the gpio matrix was clock gated, so the isr may never see it.
+    // if it does, it finds the level already handled
+    doorbell_rung_interrupt(NULL);
+
+    return ESP_OK;
+}
+
+static void long_press_timer_expired_callback(void *args)
+{
+    // the pin is moving, the debounce timer owns the state until it settles, look again after it
+    if (atomic_exchange(&debouncing, true))
+    {
+        esp_timer_start_once(long_press_timer, DOORBELL_DEBOUNCE_TIME * 1000);
+
+        return;
+    }
+
+    if (stable_level)
+    {
+        press_queue_push(last_press_time, DoorbellPressType_Long);
+
+        notify_doorbell_thread(DOORBELL_NOTIFY_PRESS, false);
+    }
+
+    // hands the state back through the debounce timer, which picks up any edge the isr dropped in the meantime
+    esp_timer_start_once(debounce_timer, DOORBELL_DEBOUNCE_TIME * 1000);
+}
+
+static void log_doorbell_diagnostics()
+{
+    ESP_LOGI(TAG, "long press, dumping diagnostics...");
+
+    ESP_LOGI(TAG, "uptime: %" PRId64 " s", esp_timer_get_time() / 1000000);
+#if !CONFIG_IDF_TARGET_LINUX
+    ESP_LOGI(TAG, "free heap: %" PRIu32 " bytes (minimum %" PRIu32 ")", esp_get_free_heap_size(), esp_get_minimum_free_heap_size());
+#endif
+    ESP_LOGI(TAG, "presses dropped: %" PRIu32, press_queue_dropped());
+    ESP_LOGI(TAG, "socket connected: %s", (xEventGroupGetBits(websocket_events) & SOCKET_CONNECTED) ? "yes" : "no");
+    ESP_LOGI(TAG, "last ring:");
+
+    latency_log_trace();
+
+    trace_dump();
+
+    dump_sleep_inhibits();
 }
 
 void doorbell_thread_entrypoint(void * arg)
 {
+    struct DoorbellPress presses[PRESS_QUEUE_SIZE];
+
+    // presses queue up in the meantime, the ring path needs the status and socket state
+    wait_for_startup();
+
     while (1)
     {
-        if (xEventGroupWaitBits(doorbell_events, DOORBELL_PRESSED, pdFALSE, pdFALSE, portMAX_DELAY) & DOORBELL_PRESSED)
+        uint32_t notified = 0;
+
+        xTaskNotifyWait(0, UINT32_MAX, &notified, portMAX_DELAY);
+
+        int64_t thread_wake_time = esp_timer_get_time();
+
+        // everything that piled up since the last ring (including presses made while it was in flight) goes out as one ring
+        bool pressed = notified & DOORBELL_NOTIFY_PRESS;
+
+        // taken before the queue is emptied, so a press is always either queued or holding off deep sleep
+        if (pressed)
         {
-            ESP_LOGI(TAG, "doorbell rung");
+            take_sleep_inhibit(SleepInhibit_Ring);
+        }
+
+        int press_count = pressed ? press_queue_drain(presses, PRESS_QUEUE_SIZE) : 0;
 
-            if (!took_sleep_inhibit)
+        // only short presses ring. a double's first press already rang as a short one, and long presses are
+        // for whoever is debugging the doorbell
+        int ring_press_count = 0;
+        int double_press_count = 0;
+        int long_press_count = 0;
+        int64_t first_ring_press_time = 0;
+
+        for (int i = 0; i < press_count; i++)
+        {
+            if (presses[i].type == DoorbellPressType_Short)
+            {
+                if (ring_press_count == 0)
+                {
+                    first_ring_press_time = presses[i].time;
+                }
+
+                ring_press_count++;
+            }
+            else if (presses[i].type == DoorbellPressType_Double)
             {
-                take_sleep_inhibit();
-                took_sleep_inhibit = true;
+                double_press_count++;
             }
+            else
+            {
+                long_press_count++;
+            }
+        }
 
-            xEventGroupClearBits(doorbell_events, DOORBELL_FINISHED_RINGING);
+        if (double_press_count > 0)
+        {
+            ESP_LOGI(TAG, "double press, already rang for its first press");
+        }
 
-            update_ringing_status(RingingStatus_Sending);
-            ring_doorbell(false);
+        if (long_press_count > 0)
+        {
+            log_doorbell_diagnostics();
+        }
+
+        if (press_count > 0)
+        {
+            for (int i = 0; i < press_count; i++)
+            {
+                trace(TraceEvent_Press, presses[i].sequence, presses[i].type);
+            }
 
-            xEventGroupWaitBits(doorbell_events, DOORBELL_FINISHED_RINGING, pdTRUE, pdFALSE, portMAX_DELAY);
+            if (press_count > 1)
+            {
+                trace(TraceEvent_PressesCoalesced, presses[0].sequence, presses[press_count - 1].sequence);
+            }
+
+            if (presses[0].sequence != expected_sequence)
+            {
+                ESP_LOGI(TAG, "%" PRIu32 " presses dropped, queue was full", presses[0].sequence - expected_sequence);
+            }
+
+            expected_sequence = presses[press_count - 1].sequence + 1;
+        }
+
+        if (ring_press_count > 0)
+        {
+            latency_reset();
+            latency_mark_at(LatencyStage_Interrupt, first_ring_press_time);
+            latency_mark_at(LatencyStage_ThreadWake, thread_wake_time);
+
+            bool wake_press = woke_from_press;
+            woke_from_press = false;
+
+            xEventGroupSetBits(doorbell_events, DOORBELL_RINGING);
 
-            xEventGroupClearBits(doorbell_events, DOORBELL_PRESSED);
             xEventGroupClearBits(doorbell_events, DOORBELL_FINISHED_RINGING);
 
-            if (took_sleep_inhibit)
+            update_ringing_status(RingingStatus_Sending);
+            ring_doorbell(wake_press);
+
+            if (wake_press)
             {
-                return_sleep_inhibit();
-                took_sleep_inhibit = false;
+                latency_log_trace();
             }
+
+            if (!(xEventGroupWaitBits(doorbell_events, DOORBELL_FINISHED_RINGING, pdTRUE, pdFALSE, DOORBELL_RING_TIMEOUT / portTICK_PERIOD_MS) & DOORBELL_FINISHED_RINGING))
+            {
+                ESP_LOGI(TAG, "ring never finished, giving up on it");
+
+                update_ringing_status(RingingStatus_Off);
+            }
+
+            xEventGroupClearBits(doorbell_events, DOORBELL_RINGING);
+            xEventGroupClearBits(doorbell_events, DOORBELL_FINISHED_RINGING);
+        }
+
+        if (pressed)
+        {
+            return_sleep_inhibit(SleepInhibit_Ring);
         }
     }
 }
@@ -67,8 +343,6 @@ void start_doorbell()
 
     doorbell_events = xEventGroupCreate();
 
-    took_sleep_inhibit = false;
-
     ESP_LOGI(TAG, "initializing io...");
 
     esp_rom_gpio_pad_select_gpio(DOORBELL_PIN);
@@ -78,14 +352,60 @@ void start_doorbell()
         .mode = GPIO_MODE_INPUT,
         .pull_down_en = GPIO_PULLDOWN_ENABLE,
         .pull_up_en = GPIO_PULLUP_DISABLE,
-        .intr_type = GPIO_INTR_HIGH_LEVEL
+        .intr_type = GPIO_INTR_ANYEDGE
     };
     ESP_ERROR_CHECK(gpio_config(&config));
 
+    esp_timer_create_args_t debounce_timer_args = {
+        .callback = debounce_timer_expired_callback,
+        .name = "doorbell debounce"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&debounce_timer_args, &debounce_timer));
+
+    esp_timer_create_args_t long_press_timer_args = {
+        .callback = long_press_timer_expired_callback,
+        .name = "doorbell long press"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&long_press_timer_args, &long_press_timer));
+
+    stable_level = gpio_get_level(DOORBELL_PIN);
+
+    if (is_fast_boot())
+    {
+        ESP_LOGI(TAG, "woken by the doorbell, queueing ring...");
+
+        // esp_timer starts at boot, so the press was a little before 0
+        woke_from_press = true;
+
+        last_press_time = 0;
+        press_is_double = false;
+
+        if (stable_level)
+        {
+            // still held, its release (or the long press timer) classifies it like any other press
+            esp_timer_start_once(long_press_timer, DOORBELL_LONG_PRESS_TIME * 1000);
+        }
+        else
+        {
+            // queued before the isr exists, so this is still the queue's only producer
+            press_queue_push(0, DoorbellPressType_Short);
+
+            last_press_short = true;
+            last_release_time = esp_timer_get_time();
+        }
+    }
+
     ESP_ERROR_CHECK(gpio_install_isr_service(0));
     ESP_ERROR_CHECK(gpio_isr_handler_add(DOORBELL_PIN, doorbell_rung_interrupt, NULL));
-    ESP_ERROR_CHECK(gpio_wakeup_enable(DOORBELL_PIN, GPIO_INTR_HIGH_LEVEL));
-    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+
+    // a gpio level wakeup would turn the edge interrupt into a level one for good now that we sleep on our own,
+    // ext1 watches the pin from the lp io side instead (so DOORBELL_PIN has to be an lp io, 0-7 on the c6)
+    ESP_ERROR_CHECK(esp_sleep_enable_ext1_wakeup_io(BIT64(DOORBELL_PIN), ESP_EXT1_WAKEUP_ANY_HIGH));
+
+    esp_pm_sleep_cbs_register_config_t sleep_callbacks = {
+        .exit_cb = doorbell_light_sleep_exit_callback,
+    };
+    ESP_ERROR_CHECK(esp_pm_light_sleep_register_cbs(&sleep_callbacks));
 
     ESP_LOGI(TAG, "starting thread...");
 
@@ -98,45 +418,28 @@ void start_doorbell()
         &doorbell_thread_handle
     );
 
+    // presses from before the thread existed (including the one that woke us from deep sleep) lost their notification
+    if (press_queue_count() > 0)
+    {
+        notify_doorbell_thread(DOORBELL_NOTIFY_PRESS, false);
+    }
+
     ESP_LOGI(TAG, "initialization finished");
 }
 
-void prepare_doorbell_for_sleep()
+bool doorbell_settled()
 {
-    // we don't want to trigger a double-interrupt
-    gpio_isr_handler_remove(DOORBELL_PIN);
-
-    gpio_hold_en(DOORBELL_PIN);
+    return press_queue_count() == 0 && !atomic_load(&debouncing) && !stable_level;
 }
 
-void wake_doorbell_from_sleep(bool triggered)
+void prepare_doorbell_for_deep_sleep()
 {
-    if (triggered)
-    {
-        if (!took_sleep_inhibit)
-        {
-            take_sleep_inhibit();
-            took_sleep_inhibit = true;
-        }
-
-        xEventGroupClearBits(doorbell_events, DOORBELL_FINISHED_RINGING);
-
-        update_ringing_status(RingingStatus_Sending);
-        ring_doorbell(true);
-
-        xEventGroupWaitBits(doorbell_events, DOORBELL_FINISHED_RINGING, pdTRUE, pdFALSE, portMAX_DELAY);
-
-        xEventGroupClearBits(doorbell_events, DOORBELL_PRESSED);
-        xEventGroupClearBits(doorbell_events, DOORBELL_FINISHED_RINGING);
-
-        if (took_sleep_inhibit)
-        {
-            return_sleep_inhibit();
-            took_sleep_inhibit = false;
-        }
-    }
+    gpio_isr_handler_remove(DOORBELL_PIN);
 
-    gpio_hold_dis(DOORBELL_PIN);
+    esp_timer_stop(debounce_timer);
+    esp_timer_stop(long_press_timer);
 
-    gpio_isr_handler_add(DOORBELL_PIN, doorbell_rung_interrupt, NULL);
+    // the digital pulldown is powered down with everything else, the lp io one keeps the pin low for ext1
+    rtc_gpio_pullup_dis(DOORBELL_PIN);
+    rtc_gpio_pulldown_en(DOORBELL_PIN);
 }
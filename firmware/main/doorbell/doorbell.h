@@ -2,19 +2,32 @@
 #define DOORBELL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 
 #define DOORBELL_PIN 3
 
+// how long a ring may wait for the server's reply before the doorbell gives up on it
+#define DOORBELL_RING_TIMEOUT 30000
+
+#define DOORBELL_DEBOUNCE_TIME      30
+#define DOORBELL_LONG_PRESS_TIME    2000
+#define DOORBELL_DOUBLE_PRESS_TIME  400
+
+// task notification bits for the doorbell thread
+#define DOORBELL_NOTIFY_PRESS       BIT0
+
 extern EventGroupHandle_t doorbell_events;
-#define DOORBELL_PRESSED            BIT0
+#define DOORBELL_RINGING            BIT0
 #define DOORBELL_FINISHED_RINGING   BIT1
 
 void start_doorbell();
 
-void prepare_doorbell_for_sleep();
-void wake_doorbell_from_sleep(bool triggered);
+// no press held, settling or waiting in the queue. once the button is up a press left behind would never wake us again
+bool doorbell_settled();
+
+void prepare_doorbell_for_deep_sleep();
 
 #endif
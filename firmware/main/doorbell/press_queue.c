@@ -0,0 +1,69 @@
+#include "press_queue.h"
+
+#include <stdatomic.h>
+
+#include "esp_attr.h"
+
+static struct DoorbellPress presses[PRESS_QUEUE_SIZE];
+
+// free running, only the producer writes head and only the consumer writes tail
+static atomic_uint_fast32_t press_head;
+static atomic_uint_fast32_t press_tail;
+
+// rtc memory, so press numbers keep counting through deep sleep
+static RTC_DATA_ATTR uint32_t next_sequence;
+static atomic_uint_fast32_t dropped_presses;
+
+bool IRAM_ATTR press_queue_push(int64_t time, enum DoorbellPressType type)
+{
+    uint32_t head = atomic_load_explicit(&press_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&press_tail, memory_order_acquire);
+
+    uint32_t sequence = next_sequence++;
+
+    if (head - tail >= PRESS_QUEUE_SIZE)
+    {
+        atomic_fetch_add_explicit(&dropped_presses, 1, memory_order_relaxed);
+        return false;
+    }
+
+    presses[head & (PRESS_QUEUE_SIZE - 1)] = (struct DoorbellPress) {
+        .sequence = sequence,
+        .time = time,
+        .type = type,
+    };
+
+    // publish the record before the consumer can see the new head
+    atomic_store_explicit(&press_head, head + 1, memory_order_release);
+
+    return true;
+}
+
+int press_queue_drain(struct DoorbellPress *drained, int max_presses)
+{
+    uint32_t tail = atomic_load_explicit(&press_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&press_head, memory_order_acquire);
+
+    int count = 0;
+
+    while (tail != head && count < max_presses)
+    {
+        drained[count++] = presses[tail & (PRESS_QUEUE_SIZE - 1)];
+        tail++;
+    }
+
+    // hand the slots back only after they were copied out
+    atomic_store_explicit(&press_tail, tail, memory_order_release);
+
+    return count;
+}
+
+uint32_t press_queue_count()
+{
+    return atomic_load_explicit(&press_head, memory_order_acquire) - atomic_load_explicit(&press_tail, memory_order_acquire);
+}
+
+uint32_t press_queue_dropped()
+{
+    return atomic_load_explicit(&dropped_presses, memory_order_relaxed);
+}
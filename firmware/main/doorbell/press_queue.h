@@ -0,0 +1,35 @@
+#ifndef PRESS_QUEUE_H
+#define PRESS_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// must be a power of two
+#define PRESS_QUEUE_SIZE 16
+
+enum DoorbellPressType {
+    // reported on release, once it's clear the press wasn't a long one
+    DoorbellPressType_Short = 0,
+    // the second half of a double press: a short press starting shortly after a short one was released.
+    // the first half is still reported (and rung) as a short press, so rings don't wait to rule a double out
+    DoorbellPressType_Double = 1,
+    // reported once it has been held for DOORBELL_LONG_PRESS_TIME, asks for diagnostics instead of a ring
+    DoorbellPressType_Long = 2,
+};
+
+struct DoorbellPress {
+    // counts every press, including dropped ones, so gaps show presses the queue had no room for
+    uint32_t sequence;
+    // esp_timer microseconds
+    int64_t time;
+    enum DoorbellPressType type;
+};
+
+// single producer (whoever owns the debounced pin state, or a fast boot before the isr is installed), single consumer (the doorbell thread)
+bool press_queue_push(int64_t time, enum DoorbellPressType type);
+int press_queue_drain(struct DoorbellPress *presses, int max_presses);
+
+uint32_t press_queue_count();
+uint32_t press_queue_dropped();
+
+#endif
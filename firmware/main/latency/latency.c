@@ -0,0 +1,63 @@
+#include "latency.h"
+
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "latency";
+
+volatile int64_t latency_stage_times[LatencyStage_Count];
+
+static const char *stage_names[LatencyStage_Count] = {
+    [LatencyStage_Interrupt] = "interrupt",
+    [LatencyStage_ThreadWake] = "thread wake",
+    [LatencyStage_RingDoorbell] = "ring_doorbell",
+    [LatencyStage_SocketConnected] = "socket up",
+    [LatencyStage_Send] = "send_text",
+    [LatencyStage_Sent] = "send returned",
+    [LatencyStage_ServerArrival] = "server arrival",
+};
+
+void latency_reset()
+{
+    for (int i = 0; i < LatencyStage_Count; i++)
+    {
+        latency_stage_times[i] = 0;
+    }
+}
+
+void IRAM_ATTR latency_mark(enum LatencyStage stage)
+{
+    latency_stage_times[stage] = esp_timer_get_time();
+}
+
+void IRAM_ATTR latency_mark_at(enum LatencyStage stage, int64_t time)
+{
+    latency_stage_times[stage] = time;
+}
+
+const char *latency_stage_name(enum LatencyStage stage)
+{
+    if (stage < 0 || stage >= LatencyStage_Count)
+    {
+        return "unknown";
+    }
+
+    return stage_names[stage];
+}
+
+void latency_log_trace()
+{
+    int64_t interrupt = latency_stage_times[LatencyStage_Interrupt];
+
+    for (int stage = LatencyStage_ThreadWake; stage < LatencyStage_Count; stage++)
+    {
+        if (latency_stage_times[stage] != 0)
+        {
+            ESP_LOGI(TAG, "%s: +%" PRId64 " ms", stage_names[stage], (latency_stage_times[stage] - interrupt) / 1000);
+        }
+    }
+}
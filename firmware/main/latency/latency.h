@@ -0,0 +1,30 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+enum LatencyStage {
+    LatencyStage_Interrupt = 0,
+    LatencyStage_ThreadWake = 1,
+    LatencyStage_RingDoorbell = 2,
+    LatencyStage_SocketConnected = 3,
+    LatencyStage_Send = 4,
+    LatencyStage_Sent = 5,
+    LatencyStage_ServerArrival = 6,
+    LatencyStage_Count = 7,
+};
+
+// timestamps (esp_timer microseconds) of the press currently moving through the ring path, 0 if not reached yet
+extern volatile int64_t latency_stage_times[LatencyStage_Count];
+
+void latency_reset();
+
+void latency_mark(enum LatencyStage stage);
+void latency_mark_at(enum LatencyStage stage, int64_t time);
+
+const char *latency_stage_name(enum LatencyStage stage);
+
+// logs every stage the current press reached, relative to the interrupt
+void latency_log_trace();
+
+#endif
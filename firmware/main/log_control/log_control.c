@@ -0,0 +1,65 @@
+#include "log_control.h"
+
+#include <string.h>
+
+static const char *TAG = "log_control";
+
+struct LogLevelName {
+    const char *name;
+    esp_log_level_t level;
+};
+
+static const struct LogLevelName log_level_names[] = {
+    { "none", ESP_LOG_NONE },
+    { "error", ESP_LOG_ERROR },
+    { "warn", ESP_LOG_WARN },
+    { "info", ESP_LOG_INFO },
+    { "debug", ESP_LOG_DEBUG },
+    { "verbose", ESP_LOG_VERBOSE },
+};
+
+bool set_log_level(const char *tag, const char *level)
+{
+    for (int i = 0; i < sizeof(log_level_names) / sizeof(log_level_names[0]); i++)
+    {
+        if (strcmp(level, log_level_names[i].name) == 0)
+        {
+            esp_log_level_set(tag, log_level_names[i].level);
+
+            ESP_LOGI(TAG, "log level for %s set to %s", tag, level);
+
+            return true;
+        }
+    }
+
+    ESP_LOGI(TAG, "unknown log level %s!", level);
+
+    return false;
+}
+
+bool run_log_command(const char *command, int length)
+{
+    char buffer[LOG_CONTROL_MAX_COMMAND];
+
+    if (length <= 0 || length >= LOG_CONTROL_MAX_COMMAND)
+    {
+        ESP_LOGI(TAG, "log command too long!");
+        return false;
+    }
+
+    // socket payloads aren't terminated
+    memcpy(buffer, command, length);
+    buffer[length] = '\0';
+
+    char *save = NULL;
+    char *tag = strtok_r(buffer, " \t\r\n", &save);
+    char *level = strtok_r(NULL, " \t\r\n", &save);
+
+    if (tag == NULL || level == NULL)
+    {
+        ESP_LOGI(TAG, "log command needs a tag and a level!");
+        return false;
+    }
+
+    return set_log_level(tag, level);
+}
@@ -0,0 +1,23 @@
+#ifndef LOG_CONTROL_H
+#define LOG_CONTROL_H
+
+#include <stdbool.h>
+
+#include "esp_log.h"
+
+// the press-to-send path and the socket frames are traced, not logged (see trace.h). debug builds still print
+// those records as they come in, release builds (NDEBUG, CONFIG_COMPILER_OPTIMIZATION_ASSERTIONS_DISABLE) only keep them in ram
+#ifndef NDEBUG
+#define LOG_HOT_PATHS
+#endif
+
+#define LOG_CONTROL_MAX_COMMAND 64
+
+// level is none, error, warn, info, debug or verbose, tag "*" sets every module.
+// levels above CONFIG_LOG_MAXIMUM_LEVEL were compiled out and stay silent
+bool set_log_level(const char *tag, const char *level);
+
+// "<tag> <level>", as sent over the socket or typed into the sim console
+bool run_log_command(const char *command, int length);
+
+#endif
@@ -3,8 +3,15 @@
 #include "doorbell/doorbell.h"
 #include "status/status.h"
 #include "wifi/wifi.h"
+#include "trace/trace.h"
+#include "boot_profile/boot_profile.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include "sim/sim.h"
+#endif
 
 #include <string.h>
+#include <inttypes.h>
 
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -14,72 +21,230 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "esp_pm.h"
 #include "esp_sleep.h"
+#include "esp_timer.h"
 
 static const char *TAG = "main";
 
-static SemaphoreHandle_t sleep_inhibit_count;
-static TimerHandle_t sleep_timer;
+struct SleepInhibitLock {
+    const char *name;
+    esp_pm_lock_type_t type;
+};
+
+// work that's racing the user (booting, ringing, handshaking) also wants the full cpu clock
+static const struct SleepInhibitLock sleep_inhibit_types[SleepInhibit_Count] = {
+    [SleepInhibit_Boot] = { "boot", ESP_PM_CPU_FREQ_MAX },
+    [SleepInhibit_Ring] = { "ring", ESP_PM_CPU_FREQ_MAX },
+    [SleepInhibit_TlsHandshake] = { "tls handshake", ESP_PM_CPU_FREQ_MAX },
+    [SleepInhibit_LedAnimation] = { "led animation", ESP_PM_NO_LIGHT_SLEEP },
+};
+
+static esp_pm_lock_handle_t sleep_inhibit_locks[SleepInhibit_Count];
+
+#ifdef SLEEP_USE_DEEP_SLEEP
+static esp_timer_handle_t deep_sleep_timer;
+#endif
+
+static bool fast_boot;
+
+// wifi comes up on its own task while app_main brings up status, the doorbell doesn't wait for either
+#define STARTUP_STATUS_STARTED  BIT0
+#define STARTUP_WIFI_STARTED    BIT1
 
-void light_sleep()
+static EventGroupHandle_t startup_events;
+
+// each inhibit is only ever taken and returned by its owner's task, so this needs no lock of its own
+struct SleepInhibitRecord {
+    int holds;
+    uint32_t acquisitions;
+    int64_t held_since;
+    int64_t last_returned;
+    int64_t total_held;
+    int64_t longest_hold;
+};
+
+static struct SleepInhibitRecord sleep_inhibit_records[SleepInhibit_Count];
+
+void take_sleep_inhibit(enum SleepInhibit inhibit)
 {
-    prepare_doorbell_for_sleep();
-    prepare_wifi_for_sleep();
-    prepare_status_for_sleep();
+    struct SleepInhibitRecord *record = &sleep_inhibit_records[inhibit];
 
-    esp_light_sleep_start();
+    if (record->holds++ == 0)
+    {
+        record->held_since = esp_timer_get_time();
+    }
 
-    uint32_t wakeup_causes = esp_sleep_get_wakeup_cause();
+    record->acquisitions++;
 
-    wake_status_from_sleep();
-    wake_wifi_from_sleep();
-    wake_doorbell_from_sleep(wakeup_causes & BIT(ESP_SLEEP_WAKEUP_GPIO));
+    // without power management (or before start_sleep) there's nothing to hold off, the accounting still runs
+    if (sleep_inhibit_locks[inhibit] != NULL)
+    {
+        esp_pm_lock_acquire(sleep_inhibit_locks[inhibit]);
+    }
+
+    ESP_LOGD(TAG, "%s sleep inhibit taken", sleep_inhibit_types[inhibit].name);
 }
 
-void sleep_timer_expired_callback(TimerHandle_t expired_sleep_timer)
+void return_sleep_inhibit(enum SleepInhibit inhibit)
 {
-    ESP_LOGI(TAG, "sleep triggered, good night!");
+    struct SleepInhibitRecord *record = &sleep_inhibit_records[inhibit];
+
+    if (record->holds == 0)
+    {
+        ESP_LOGI(TAG, "%s sleep inhibit returned without being taken!", sleep_inhibit_types[inhibit].name);
+
+        return;
+    }
+
+    if (--record->holds == 0)
+    {
+        record->last_returned = esp_timer_get_time();
+
+        int64_t held = record->last_returned - record->held_since;
+
+        record->total_held += held;
+
+        if (held > record->longest_hold)
+        {
+            record->longest_hold = held;
+        }
 
-    xTimerStop(sleep_timer, 0);
+#ifdef SLEEP_USE_DEEP_SLEEP
+        // the idle countdown runs from the end of the last ring (or boot), not from every led fade
+        if (inhibit == SleepInhibit_Boot || inhibit == SleepInhibit_Ring)
+        {
+            esp_timer_stop(deep_sleep_timer);
+            esp_timer_start_once(deep_sleep_timer, DEEP_SLEEP_IDLE_TIME * 1000);
+        }
+#endif
+    }
+
+    if (sleep_inhibit_locks[inhibit] != NULL)
+    {
+        esp_pm_lock_release(sleep_inhibit_locks[inhibit]);
+    }
+
+    ESP_LOGD(TAG, "%s sleep inhibit returned", sleep_inhibit_types[inhibit].name);
+}
 
-    light_sleep();
+void dump_sleep_inhibits()
+{
+    int64_t now = esp_timer_get_time();
 
-    ESP_LOGI(TAG, "sleep finished, good morning!");
+    ESP_LOGI(TAG, "sleep inhibits over %" PRId64 " s of uptime:", now / 1000000);
 
-    xTimerReset(sleep_timer, 0);
+    for (int i = 0; i < SleepInhibit_Count; i++)
+    {
+        struct SleepInhibitRecord record = sleep_inhibit_records[i];
+
+        // a hold that's still going counts up to now
+        int64_t current_hold = record.holds > 0 ? now - record.held_since : 0;
+        int64_t total_held = record.total_held + current_hold;
+        int64_t longest_hold = current_hold > record.longest_hold ? current_hold : record.longest_hold;
+
+        ESP_LOGI(
+            TAG, "%-14s %s for %" PRId64 " ms, taken %" PRIu32 " times, held %" PRId64 " ms total (%" PRId64 ".%" PRId64 "%%), longest %" PRId64 " ms",
+            sleep_inhibit_types[i].name, record.holds > 0 ? "held" : "free",
+            (now - (record.holds > 0 ? record.held_since : record.last_returned)) / 1000, record.acquisitions,
+            total_held / 1000, total_held * 100 / now, (total_held * 1000 / now) % 10, longest_hold / 1000
+        );
+    }
 }
 
-void take_sleep_inhibit()
+bool is_fast_boot()
 {
-    ESP_LOGI(TAG, "sleep inhibit taken");
+    return fast_boot;
+}
 
-    xSemaphoreTake(sleep_inhibit_count, portMAX_DELAY);
+#ifdef SLEEP_USE_DEEP_SLEEP
+static void deep_sleep_timer_expired_callback(void *arg)
+{
+    // not the led animation, looping patterns (wifi down, updating) hold it for good and deep sleep turns the leds off anyway.
+    // the doorbell first: the thread takes the ring inhibit before it empties the queue, so checking in this order misses nothing
+    if (!doorbell_settled()
+        || sleep_inhibit_records[SleepInhibit_Boot].holds > 0
+        || sleep_inhibit_records[SleepInhibit_Ring].holds > 0
+        || sleep_inhibit_records[SleepInhibit_TlsHandshake].holds > 0)
+    {
+        esp_timer_start_once(deep_sleep_timer, DEEP_SLEEP_RETRY_TIME * 1000);
 
-    xTimerStop(sleep_timer, portMAX_DELAY);
+        return;
+    }
+
+    ESP_LOGI(TAG, "nothing rang for %d s, deep sleep triggered, good night!", DEEP_SLEEP_IDLE_TIME / 1000);
+
+    prepare_wifi_for_deep_sleep();
+    prepare_doorbell_for_deep_sleep();
+
+    // the doorbell's ext1 wakeup is armed for light sleep already and works the same here
+    esp_deep_sleep_start();
 }
+#endif
 
-void return_sleep_inhibit()
+static void start_sleep()
 {
-    ESP_LOGI(TAG, "sleep inhibit returned");
+    for (int i = 0; i < SleepInhibit_Count; i++)
+    {
+        if (esp_pm_lock_create(sleep_inhibit_types[i].type, 0, sleep_inhibit_types[i].name, &sleep_inhibit_locks[i]) != ESP_OK)
+        {
+            ESP_LOGI(TAG, "couldn't create the %s sleep inhibit, it won't keep us awake", sleep_inhibit_types[i].name);
 
-    xSemaphoreGive(sleep_inhibit_count);
+            sleep_inhibit_locks[i] = NULL;
+        }
+    }
 
-    if (uxSemaphoreGetCount(sleep_inhibit_count) == MAX_SLEEP_HANDLES)
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = SLEEP_MAX_CPU_FREQ,
+        .min_freq_mhz = SLEEP_MIN_CPU_FREQ,
+        .light_sleep_enable = true
+    };
+
+    // wifi stays associated through it, modem sleep wakes us for the beacons
+    esp_err_t ret = esp_pm_configure(&pm_config);
+
+    if (ret != ESP_OK)
     {
-        xTimerReset(sleep_timer, portMAX_DELAY);
+        ESP_LOGI(TAG, "automatic light sleep unavailable (%s), staying awake", esp_err_to_name(ret));
     }
+
+#ifdef SLEEP_USE_DEEP_SLEEP
+    esp_timer_create_args_t deep_sleep_timer_args = {
+        .callback = deep_sleep_timer_expired_callback,
+        .name = "deep sleep"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&deep_sleep_timer_args, &deep_sleep_timer));
+#endif
 }
 
-void app_main(void)
+void wait_for_status_startup()
 {
+    xEventGroupWaitBits(startup_events, STARTUP_STATUS_STARTED, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+void wait_for_startup()
+{
+    xEventGroupWaitBits(startup_events, STARTUP_STATUS_STARTED | STARTUP_WIFI_STARTED, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+static void wifi_startup_thread_entrypoint(void * arg)
+{
+    boot_phase_begin(BootPhase_Nvs);
+
+    // the wifi driver needs nvs either way. a fast boot doesn't try to repair it,
+    // if it's broken we reset and the full boot after that does
     esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    if (!fast_boot && (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND))
     {
         ESP_ERROR_CHECK(nvs_flash_erase());
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
 
+    boot_phase_end(BootPhase_Nvs);
+
+    boot_phase_begin(BootPhase_EventLoop);
+
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
     if (CONFIG_LOG_MAXIMUM_LEVEL > CONFIG_LOG_DEFAULT_LEVEL)
@@ -87,38 +252,88 @@ void app_main(void)
         esp_log_level_set("wifi", CONFIG_LOG_MAXIMUM_LEVEL);
     }
 
-    ESP_LOGI(TAG, "start sleep service");
+    boot_phase_end(BootPhase_EventLoop);
 
-    sleep_inhibit_count = xSemaphoreCreateCounting(MAX_SLEEP_HANDLES, MAX_SLEEP_HANDLES);
+    ESP_LOGI(TAG, "start wifi");
 
-    // sleep after 10 minutes: 600000
-    // sleep after 20 seconds: 20000
-    sleep_timer = xTimerCreate(
-        "sleep timer",
-        600000 / portTICK_PERIOD_MS,
-        pdFALSE,
-        (void *) 0,
-        sleep_timer_expired_callback
-    );
-    xTimerStart(sleep_timer, portMAX_DELAY);
+    start_wifi();
 
-    take_sleep_inhibit();
+    xEventGroupSetBits(startup_events, STARTUP_WIFI_STARTED);
 
-    ESP_LOGI(TAG, "start status");
+    vTaskDelete(NULL);
+}
 
-    start_status();
+void app_main(void)
+{
+    int64_t app_main_start_time = esp_timer_get_time();
 
-    ESP_LOGI(TAG, "start wifi");
+#if CONFIG_IDF_TARGET_LINUX
+    start_sim();
+#endif
 
-    start_wifi();
+    // only a deep sleep wake has a wakeup cause at boot, and the doorbell is our only ext1 source
+    fast_boot = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT1;
+
+    if (fast_boot)
+    {
+        ESP_LOGI(TAG, "woken by the doorbell, fast boot");
+    }
+
+    startup_events = xEventGroupCreate();
+
+    boot_phase_begin(BootPhase_Trace);
+
+    start_trace();
+
+    boot_phase_end(BootPhase_Trace);
+
+    ESP_LOGI(TAG, "start sleep service");
+
+    boot_phase_begin(BootPhase_Sleep);
+
+    start_sleep();
+
+    take_sleep_inhibit(SleepInhibit_Boot);
+
+    boot_phase_end(BootPhase_Sleep);
 
     ESP_LOGI(TAG, "start doorbell");
 
+    // first, so presses are queued within a few ms of reset. the doorbell thread holds them until status and wifi are up,
+    // on a fast boot that includes the waking press
+    boot_phase_begin(BootPhase_Doorbell);
+
     start_doorbell();
 
+    boot_phase_end(BootPhase_Doorbell);
+
+    // nvs and the wifi driver are most of the boot time, at app_main's priority they share the cpu with status
+    xTaskCreate(
+        wifi_startup_thread_entrypoint,
+        "wifi startup",
+        10000,
+        NULL,
+        uxTaskPriorityGet(NULL),
+        NULL
+    );
+
+    ESP_LOGI(TAG, "start status");
+
+    boot_phase_begin(BootPhase_Status);
+
+    start_status();
+
+    boot_phase_end(BootPhase_Status);
+
+    xEventGroupSetBits(startup_events, STARTUP_STATUS_STARTED);
+
+    wait_for_startup();
+
     ESP_LOGI(TAG, "system ready");
 
     ready_status();
 
-    return_sleep_inhibit();
+    boot_profile_log(app_main_start_time, esp_timer_get_time());
+
+    return_sleep_inhibit(SleepInhibit_Boot);
 }
@@ -1,9 +1,42 @@
 #ifndef MAIN_H
 #define MAIN_H
 
-#define MAX_SLEEP_HANDLES 15
+#include <stdbool.h>
 
-void take_sleep_inhibit();
-void return_sleep_inhibit();
+// dfs range, the cpu idles at the crystal frequency and light sleeps whenever no inhibit is held
+#define SLEEP_MAX_CPU_FREQ 160
+#define SLEEP_MIN_CPU_FREQ 40
+
+// battery installs: once nothing has rung for DEEP_SLEEP_IDLE_TIME, deep sleep until the doorbell is pressed.
+// wifi and the socket are gone while asleep, so the server can't reach us and every press pays for a (fast) boot
+// #define SLEEP_USE_DEEP_SLEEP
+#define DEEP_SLEEP_IDLE_TIME 30000
+// how soon to check again when the idle time ran out while something still held us awake
+#define DEEP_SLEEP_RETRY_TIME 5000
+
+// each one is its own power management lock, and keeps its own hold time accounting
+enum SleepInhibit {
+    SleepInhibit_Boot = 0,
+    SleepInhibit_Ring = 1,
+    SleepInhibit_TlsHandshake = 2,
+    SleepInhibit_LedAnimation = 3,
+    SleepInhibit_Count = 4,
+};
+
+// counted, every take needs its own return
+void take_sleep_inhibit(enum SleepInhibit inhibit);
+void return_sleep_inhibit(enum SleepInhibit inhibit);
+
+// logs who has held us awake, for how long and how often since boot
+void dump_sleep_inhibits();
+
+// woken from deep sleep by the doorbell, boot goes straight to ringing
+bool is_fast_boot();
+
+// the doorbell starts before status and wifi, its thread waits here before it touches either
+void wait_for_startup();
+
+// start_wifi brings up the wifi driver alongside status, only its event handler needs to wait for it
+void wait_for_status_startup();
 
 #endif
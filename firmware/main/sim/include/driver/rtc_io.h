@@ -0,0 +1,20 @@
+#ifndef SIM_DRIVER_RTC_IO_H
+#define SIM_DRIVER_RTC_IO_H
+
+// simulated stand-in for the esp-idf rtc io driver, only used by the linux target
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+// the simulated pins have no pulls to hold through deep sleep
+static inline esp_err_t rtc_gpio_pullup_dis(gpio_num_t gpio_num)
+{
+    return ESP_OK;
+}
+
+static inline esp_err_t rtc_gpio_pulldown_en(gpio_num_t gpio_num)
+{
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef SIM_ESP_EAP_CLIENT_H
+#define SIM_ESP_EAP_CLIENT_H
+
+// simulated stand-in for the wpa_supplicant eap client, only used by the linux target
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+esp_err_t esp_eap_client_set_identity(const unsigned char *identity, int len);
+esp_err_t esp_eap_client_set_username(const unsigned char *username, int len);
+esp_err_t esp_eap_client_set_password(const unsigned char *password, int len);
+esp_err_t esp_eap_client_set_domain_name(const char *domain_name);
+
+esp_err_t esp_wifi_sta_enterprise_enable(void);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef SIM_ESP_MAC_H
+#define SIM_ESP_MAC_H
+
+// simulated stand-in for the esp_mac formatting helpers, only used by the linux target
+
+#define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
+#define MACSTR "%02x:%02x:%02x:%02x:%02x:%02x"
+
+#endif
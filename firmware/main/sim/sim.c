@@ -0,0 +1,166 @@
+#include "sim.h"
+
+#include "doorbell/doorbell.h"
+#include "status/status.h"
+#include "log_control/log_control.h"
+#include "trace/trace.h"
+#include "main.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_pm.h"
+#include "esp_log.h"
+
+static const char *TAG = "sim";
+
+static TaskHandle_t sim_console_thread_handle;
+
+static void run_command(char *line)
+{
+    char *command = strtok(line, " \t\r\n");
+    char *argument = strtok(NULL, " \t\r\n");
+
+    if (command == NULL)
+    {
+        return;
+    }
+
+    if (strcmp(command, "press") == 0)
+    {
+        sim_gpio_set_level(DOORBELL_PIN, 1);
+    }
+    else if (strcmp(command, "release") == 0)
+    {
+        sim_gpio_set_level(DOORBELL_PIN, 0);
+    }
+    else if (strcmp(command, "wifi") == 0 && argument != NULL && strcmp(argument, "up") == 0)
+    {
+        sim_wifi_set_available(true);
+    }
+    else if (strcmp(command, "wifi") == 0 && argument != NULL && strcmp(argument, "down") == 0)
+    {
+        sim_wifi_set_available(false);
+    }
+    else if (strcmp(command, "wifi") == 0 && argument != NULL && strcmp(argument, "lose-ip") == 0)
+    {
+        sim_wifi_lose_ip();
+    }
+    else if (strcmp(command, "led") == 0)
+    {
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++)
+        {
+            printf("led %d duty: %" PRIu32 "\n", i, sim_ledc_get_duty(LED_LS_MODE, led_channels[i].channel));
+        }
+    }
+    else if (strcmp(command, "bench") == 0 && argument != NULL)
+    {
+        char *budget = strtok(NULL, " \t\r\n");
+
+        int result = run_sim_bench(atoi(argument), budget != NULL ? atoll(budget) : 0);
+
+        // with a budget this is a regression gate, hand the verdict to whoever launched us
+        if (budget != NULL)
+        {
+            exit(result == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    else if (strcmp(command, "bench-status") == 0 && argument != NULL)
+    {
+        run_sim_status_bench(atoi(argument));
+    }
+    else if (strcmp(command, "render") == 0 && argument != NULL)
+    {
+        char *data = strtok(NULL, " \t\r\n");
+        char *budget = strtok(NULL, " \t\r\n");
+
+        int result = run_sim_render(atoi(argument), data != NULL ? atoi(data) : 0, budget != NULL ? atoll(budget) : 0);
+
+        // same as bench, a budget makes this a regression gate
+        if (budget != NULL)
+        {
+            exit(result == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    else if (strcmp(command, "log") == 0 && argument != NULL)
+    {
+        char *level = strtok(NULL, " \t\r\n");
+
+        if (level != NULL)
+        {
+            set_log_level(argument, level);
+        }
+    }
+    else if (strcmp(command, "pm") == 0)
+    {
+        esp_pm_dump_locks(stdout);
+        dump_sleep_inhibits();
+    }
+    else if (strcmp(command, "trace") == 0)
+    {
+        trace_dump();
+    }
+    else if (strcmp(command, "exit") == 0)
+    {
+        exit(EXIT_SUCCESS);
+    }
+    else
+    {
+        printf("commands: press, release, wifi up|down|lose-ip, led, bench <presses> [p99 budget us], bench-status <changes>, render <pattern> [data] [budget ms], log <tag|*> <level>, trace, pm, exit\n");
+    }
+}
+
+static void sim_console_thread_entrypoint(void * arg)
+{
+    char line[SIM_CONSOLE_LINE_LENGTH];
+    size_t line_length = 0;
+
+    // a blocking read would stall the whole simulated scheduler, so poll instead
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+
+    while (1)
+    {
+        char character;
+
+        if (read(STDIN_FILENO, &character, 1) != 1)
+        {
+            vTaskDelay(SIM_CONSOLE_POLL_TIME / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        if (character == '\n' || line_length == sizeof(line) - 1)
+        {
+            line[line_length] = '\0';
+            line_length = 0;
+
+            run_command(line);
+        }
+        else
+        {
+            line[line_length++] = character;
+        }
+    }
+}
+
+void start_sim()
+{
+    start_sim_server();
+
+    ESP_LOGI(TAG, "starting simulated hardware console...");
+
+    xTaskCreate(
+        sim_console_thread_entrypoint,
+        "sim console",
+        10000,
+        NULL,
+        tskIDLE_PRIORITY + 1,
+        &sim_console_thread_handle
+    );
+}
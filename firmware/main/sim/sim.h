@@ -0,0 +1,65 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+
+#include "status/pattern_driver_thread.h"
+
+// how long the simulated access point takes to associate and hand out an ip
+#define SIM_WIFI_ASSOCIATE_TIME   50
+#define SIM_WIFI_DHCP_TIME        20
+// added to a join that doesn't name the bssid and channel up front
+#define SIM_WIFI_SCAN_TIME        100
+#define SIM_WIFI_CHANNEL          6
+#define SIM_WIFI_BSSID            { 0x02, 0x00, 0x00, 0xd0, 0x0b, 0xe1 }
+
+#define SIM_CONSOLE_POLL_TIME     10
+#define SIM_CONSOLE_LINE_LENGTH   128
+
+// local stand-in for the api server, see SOCKET_URI
+#define SIM_SERVER_PORT           8080
+#define SIM_SERVER_RING_TIME      2000
+#define SIM_SERVER_MAX_REQUEST    1024
+#define SIM_SERVER_MAX_PAYLOAD    1024
+
+#define SIM_BENCH_MAX_PRESSES     10000
+#define SIM_BENCH_CONNECT_TIMEOUT 10000
+#define SIM_BENCH_PRESS_TIMEOUT   15000
+#define SIM_BENCH_MAX_STATUS_CHANGES 1000
+#define SIM_BENCH_PATTERN_TIMEOUT 1000
+
+#define SIM_RENDER_TIMEOUT        30000
+
+#define SIM_PM_MAX_LOCKS          16
+
+void start_sim();
+
+void sim_gpio_set_level(gpio_num_t gpio_num, int level);
+
+// wakes the simulated automatic light sleep if the pin is an ext1 source
+void sim_pm_pin_changed(gpio_num_t gpio_num, int level);
+
+uint32_t sim_ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel);
+
+void sim_wifi_set_available(bool available);
+void sim_wifi_lose_ip();
+
+void start_sim_server();
+void sim_server_set_ring_time(int ring_time_ms);
+uint32_t sim_server_arrivals();
+
+// returns 0 when every press reached the server within the p99 budget (a budget of 0 only reports)
+int run_sim_bench(int presses, int64_t p99_budget);
+
+// times the status setters, and a setter call to the led pattern changing
+int run_sim_status_bench(int changes);
+
+// plays one pass of a pattern and prints its duty over time as csv.
+// returns 0 when the pass fits in the budget (a budget of 0 only reports)
+int run_sim_render(enum CurrentPattern pattern, int data, int64_t budget_ms);
+
+#endif
@@ -0,0 +1,250 @@
+#include "sim.h"
+
+#include "doorbell/doorbell.h"
+#include "doorbell/press_queue.h"
+#include "wifi/socket.h"
+#include "status/status.h"
+#include "status/pattern_driver_thread.h"
+#include "latency/latency.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "sim (bench)";
+
+// microseconds from the interrupt to each later stage, per press
+static int64_t samples[LatencyStage_Count][SIM_BENCH_MAX_PRESSES];
+
+// microseconds from a status setter call to the driver starting the new pattern
+static int64_t status_samples[SIM_BENCH_MAX_STATUS_CHANGES];
+
+static int compare_samples(const void *a, const void *b)
+{
+    int64_t left = *(const int64_t *) a;
+    int64_t right = *(const int64_t *) b;
+
+    return (left > right) - (left < right);
+}
+
+static int64_t percentile(const int64_t *sorted, int count, int percent)
+{
+    return sorted[(count - 1) * percent / 100];
+}
+
+static bool wait_until(bool (*condition)(), int timeout_ms)
+{
+    int64_t deadline = esp_timer_get_time() + (int64_t) timeout_ms * 1000;
+
+    while (!condition())
+    {
+        if (esp_timer_get_time() > deadline)
+        {
+            return false;
+        }
+
+        vTaskDelay(1);
+    }
+
+    return true;
+}
+
+static bool socket_connected()
+{
+    return xEventGroupGetBits(websocket_events) & SOCKET_CONNECTED;
+}
+
+static bool doorbell_idle()
+{
+    return !(xEventGroupGetBits(doorbell_events) & DOORBELL_RINGING) && press_queue_count() == 0;
+}
+
+static uint32_t expected_arrivals;
+
+static bool ring_arrived()
+{
+    return sim_server_arrivals() >= expected_arrivals;
+}
+
+static int64_t previous_pattern_start_time;
+
+static bool pattern_started()
+{
+    return pattern_start_times[LED_STATUS_CHANNEL] != previous_pattern_start_time;
+}
+
+int run_sim_bench(int presses, int64_t p99_budget)
+{
+    if (presses <= 0 || presses > SIM_BENCH_MAX_PRESSES)
+    {
+        printf("bench: press count must be between 1 and %d\n", SIM_BENCH_MAX_PRESSES);
+
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "running %d presses...", presses);
+
+    sim_server_set_ring_time(0);
+
+    int completed = 0;
+    int timeouts = 0;
+
+    for (int i = 0; i < presses; i++)
+    {
+        if (!wait_until(socket_connected, SIM_BENCH_CONNECT_TIMEOUT) || !wait_until(doorbell_idle, SIM_BENCH_PRESS_TIMEOUT))
+        {
+            ESP_LOGW(TAG, "doorbell not ready for press %d", i);
+
+            timeouts++;
+            continue;
+        }
+
+        // let the previous press's debounce settle, edges inside it are ignored
+        vTaskDelay((DOORBELL_DEBOUNCE_TIME * 3) / portTICK_PERIOD_MS);
+
+        latency_reset();
+        expected_arrivals = sim_server_arrivals() + 1;
+
+        sim_gpio_set_level(DOORBELL_PIN, 1);
+        sim_gpio_set_level(DOORBELL_PIN, 0);
+
+        if (!wait_until(ring_arrived, SIM_BENCH_PRESS_TIMEOUT))
+        {
+            ESP_LOGW(TAG, "press %d never reached the server", i);
+
+            timeouts++;
+            continue;
+        }
+
+        int64_t interrupt = latency_stage_times[LatencyStage_Interrupt];
+
+        for (int stage = LatencyStage_ThreadWake; stage < LatencyStage_Count; stage++)
+        {
+            samples[stage][completed] = latency_stage_times[stage] - interrupt;
+        }
+
+        completed++;
+    }
+
+    sim_server_set_ring_time(SIM_SERVER_RING_TIME);
+
+    printf("bench: %d presses, %d completed, %d timed out\n", presses, completed, timeouts);
+
+    if (completed == 0)
+    {
+        return -1;
+    }
+
+    printf("%-16s %10s %10s %10s\n", "stage (from isr)", "p50 us", "p99 us", "max us");
+
+    int64_t arrival_p99 = 0;
+
+    for (int stage = LatencyStage_ThreadWake; stage < LatencyStage_Count; stage++)
+    {
+        qsort(samples[stage], completed, sizeof(int64_t), compare_samples);
+
+        int64_t p99 = percentile(samples[stage], completed, 99);
+
+        printf(
+            "%-16s %10" PRId64 " %10" PRId64 " %10" PRId64 "\n",
+            latency_stage_name(stage),
+            percentile(samples[stage], completed, 50),
+            p99,
+            samples[stage][completed - 1]
+        );
+
+        if (stage == LatencyStage_ServerArrival)
+        {
+            arrival_p99 = p99;
+        }
+    }
+
+    if (p99_budget > 0)
+    {
+        bool passed = timeouts == 0 && arrival_p99 <= p99_budget;
+
+        printf("bench: p99 press-to-server %" PRId64 " us, budget %" PRId64 " us: %s\n", arrival_p99, p99_budget, passed ? "PASS" : "FAIL");
+
+        return passed ? 0 : 1;
+    }
+
+    return 0;
+}
+
+int run_sim_status_bench(int changes)
+{
+    if (changes <= 0 || changes > SIM_BENCH_MAX_STATUS_CHANGES)
+    {
+        printf("bench: change count must be between 1 and %d\n", SIM_BENCH_MAX_STATUS_CHANGES);
+        return -1;
+    }
+
+    // the wifi pattern outranks the updating one we toggle
+    if (!wait_until(socket_connected, SIM_BENCH_CONNECT_TIMEOUT))
+    {
+        printf("bench: socket never connected\n");
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "running %d status changes...", changes);
+
+    // setters on their own, publishing a value that's already set so the led doesn't change
+    int64_t setter_start = esp_timer_get_time();
+
+    for (int i = 0; i < changes; i++)
+    {
+        update_ringing_status(RingingStatus_Off);
+    }
+
+    int64_t setter_time = esp_timer_get_time() - setter_start;
+
+    int completed = 0;
+    int timeouts = 0;
+
+    for (int i = 0; i < changes; i++)
+    {
+        previous_pattern_start_time = pattern_start_times[LED_STATUS_CHANNEL];
+
+        int64_t set_time = esp_timer_get_time();
+
+        update_updating_status(i % 2 == 0);
+
+        if (!wait_until(pattern_started, SIM_BENCH_PATTERN_TIMEOUT))
+        {
+            timeouts++;
+            continue;
+        }
+
+        status_samples[completed++] = pattern_start_times[LED_STATUS_CHANNEL] - set_time;
+    }
+
+    update_updating_status(false);
+
+    printf("bench: status setter %" PRId64 " ns per call over %d calls\n", setter_time * 1000 / changes, changes);
+    printf("bench: %d status changes, %d reached the led, %d timed out\n", changes, completed, timeouts);
+
+    if (completed == 0)
+    {
+        return -1;
+    }
+
+    qsort(status_samples, completed, sizeof(int64_t), compare_samples);
+
+    printf("%-16s %10s %10s %10s\n", "setter to led", "p50 us", "p99 us", "max us");
+    printf(
+        "%-16s %10" PRId64 " %10" PRId64 " %10" PRId64 "\n",
+        "pattern start",
+        percentile(status_samples, completed, 50),
+        percentile(status_samples, completed, 99),
+        status_samples[completed - 1]
+    );
+
+    return 0;
+}
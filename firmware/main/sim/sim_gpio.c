@@ -0,0 +1,112 @@
+#include "sim.h"
+
+#include <stdbool.h>
+
+#include "driver/gpio.h"
+
+#define SIM_GPIO_COUNT 32
+
+struct sim_gpio_pin {
+    int level;
+    gpio_int_type_t intr_type;
+    gpio_isr_t isr_handler;
+    void *isr_args;
+};
+
+static struct sim_gpio_pin pins[SIM_GPIO_COUNT];
+
+static bool level_triggers(gpio_int_type_t type, int old_level, int new_level)
+{
+    switch (type)
+    {
+        case GPIO_INTR_POSEDGE:
+            return old_level == 0 && new_level == 1;
+        case GPIO_INTR_NEGEDGE:
+            return old_level == 1 && new_level == 0;
+        case GPIO_INTR_ANYEDGE:
+            return old_level != new_level;
+        // a real level interrupt keeps firing while the level is held, we only fire on entry
+        case GPIO_INTR_LOW_LEVEL:
+            return old_level != 0 && new_level == 0;
+        case GPIO_INTR_HIGH_LEVEL:
+            return old_level != 1 && new_level == 1;
+        default:
+            return false;
+    }
+}
+
+void sim_gpio_set_level(gpio_num_t gpio_num, int level)
+{
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT)
+    {
+        return;
+    }
+
+    struct sim_gpio_pin *pin = &pins[gpio_num];
+
+    int old_level = pin->level;
+    pin->level = level;
+
+    // an ext1 pin going high ends the simulated light sleep before the isr sees the edge
+    sim_pm_pin_changed(gpio_num, level);
+
+    if (pin->isr_handler != NULL && level_triggers(pin->intr_type, old_level, level))
+    {
+        pin->isr_handler(pin->isr_args);
+    }
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    for (int i = 0; i < SIM_GPIO_COUNT; i++)
+    {
+        if (config->pin_bit_mask & BIT64(i))
+        {
+            pins[i].intr_type = config->intr_type;
+            pins[i].level = config->pull_up_en == GPIO_PULLUP_ENABLE ? 1 : 0;
+        }
+    }
+
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT)
+    {
+        return 0;
+    }
+
+    return pins[gpio_num].level;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pins[gpio_num].isr_handler = isr_handler;
+    pins[gpio_num].isr_args = args;
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pins[gpio_num].isr_handler = NULL;
+    pins[gpio_num].isr_args = NULL;
+
+    return ESP_OK;
+}
@@ -0,0 +1,238 @@
+#include "sim.h"
+
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+
+#include "driver/ledc.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "sim (ledc)";
+
+struct sim_ledc_channel {
+    uint32_t duty;
+    uint32_t pending_duty;
+
+    uint32_t fade_from;
+    uint32_t fade_to;
+    int fade_time;
+    int64_t fade_start;
+    bool fading;
+
+    TimerHandle_t fade_timer;
+
+    ledc_cb_t fade_cb;
+    void *fade_cb_arg;
+};
+
+static struct sim_ledc_channel channels[LEDC_SIM_CHANNEL_COUNT];
+
+static bool valid_channel(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    return speed_mode == LEDC_LOW_SPEED_MODE && channel >= 0 && channel < LEDC_SIM_CHANNEL_COUNT;
+}
+
+static uint32_t current_duty(struct sim_ledc_channel *state)
+{
+    if (!state->fading || state->fade_time <= 0)
+    {
+        return state->duty;
+    }
+
+    int64_t elapsed = (esp_timer_get_time() - state->fade_start) / 1000;
+
+    if (elapsed >= state->fade_time)
+    {
+        return state->fade_to;
+    }
+
+    int64_t delta = (int64_t) state->fade_to - (int64_t) state->fade_from;
+
+    return (uint32_t) ((int64_t) state->fade_from + delta * elapsed / state->fade_time);
+}
+
+static void fade_timer_expired_callback(TimerHandle_t fade_timer)
+{
+    ledc_channel_t channel = (ledc_channel_t) (intptr_t) pvTimerGetTimerID(fade_timer);
+    struct sim_ledc_channel *state = &channels[channel];
+
+    state->duty = state->fade_to;
+    state->fading = false;
+
+    if (state->fade_cb != NULL)
+    {
+        ledc_cb_param_t param = {
+            .event = LEDC_FADE_END_EVT,
+            .speed_mode = LEDC_LOW_SPEED_MODE,
+            .channel = channel,
+            .duty = state->duty,
+        };
+
+        state->fade_cb(&param, state->fade_cb_arg);
+    }
+}
+
+uint32_t sim_ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    if (!valid_channel(speed_mode, channel))
+    {
+        return 0;
+    }
+
+    return current_duty(&channels[channel]);
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf)
+{
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf)
+{
+    if (!valid_channel(ledc_conf->speed_mode, ledc_conf->channel))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct sim_ledc_channel *state = &channels[ledc_conf->channel];
+
+    state->duty = ledc_conf->duty;
+    state->pending_duty = ledc_conf->duty;
+    state->fading = false;
+
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags)
+{
+    for (int i = 0; i < LEDC_SIM_CHANNEL_COUNT; i++)
+    {
+        if (channels[i].fade_timer == NULL)
+        {
+            channels[i].fade_timer = xTimerCreate(
+                "sim ledc fade",
+                1,
+                pdFALSE,
+                (void *) (intptr_t) i,
+                fade_timer_expired_callback
+            );
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ledc_cb_register(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_cbs_t *cbs, void *user_arg)
+{
+    if (!valid_channel(speed_mode, channel))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    channels[channel].fade_cb = cbs->fade_cb;
+    channels[channel].fade_cb_arg = user_arg;
+
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty)
+{
+    if (!valid_channel(speed_mode, channel))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    channels[channel].pending_duty = duty;
+
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    if (!valid_channel(speed_mode, channel))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct sim_ledc_channel *state = &channels[channel];
+
+    if (state->fading)
+    {
+        xTimerStop(state->fade_timer, portMAX_DELAY);
+        state->fading = false;
+    }
+
+    state->duty = state->pending_duty;
+
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    return sim_ledc_get_duty(speed_mode, channel);
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t target_duty, int max_fade_time_ms)
+{
+    if (!valid_channel(speed_mode, channel))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct sim_ledc_channel *state = &channels[channel];
+
+    state->fade_to = target_duty;
+    state->fade_time = max_fade_time_ms;
+
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_fade_mode_t fade_mode)
+{
+    if (!valid_channel(speed_mode, channel))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct sim_ledc_channel *state = &channels[channel];
+
+    if (state->fade_timer == NULL)
+    {
+        ESP_LOGE(TAG, "fade started before ledc_fade_func_install");
+
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    state->duty = current_duty(state);
+    state->fade_from = state->duty;
+    state->fade_start = esp_timer_get_time();
+    state->fading = true;
+
+    TickType_t fade_ticks = pdMS_TO_TICKS(state->fade_time);
+
+    xTimerChangePeriod(state->fade_timer, fade_ticks > 0 ? fade_ticks : 1, portMAX_DELAY);
+
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_stop(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    if (!valid_channel(speed_mode, channel))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct sim_ledc_channel *state = &channels[channel];
+
+    if (state->fading)
+    {
+        xTimerStop(state->fade_timer, portMAX_DELAY);
+
+        state->duty = current_duty(state);
+        state->fading = false;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,167 @@
+#include "sim.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_log.h"
+
+static const char *TAG = "sim (pm)";
+
+struct esp_pm_lock {
+    const char *name;
+    esp_pm_lock_type_t type;
+    atomic_int count;
+    atomic_uint_least32_t acquisitions;
+};
+
+static const char *lock_type_names[] = {
+    [ESP_PM_CPU_FREQ_MAX] = "CPU_FREQ_MAX",
+    [ESP_PM_APB_FREQ_MAX] = "APB_FREQ_MAX",
+    [ESP_PM_NO_LIGHT_SLEEP] = "NO_SLEEP",
+};
+
+static struct esp_pm_lock locks[SIM_PM_MAX_LOCKS];
+static atomic_int lock_count;
+
+// every lock of every type holds off light sleep, like on the device
+static atomic_int held_locks;
+
+static bool light_sleep_enabled;
+
+static esp_pm_light_sleep_cb_t exit_callback;
+static void *exit_callback_arg;
+
+static uint64_t ext1_wakeup_mask;
+static esp_sleep_ext1_wakeup_mode_t ext1_wakeup_mode;
+static esp_sleep_wakeup_cause_t wakeup_cause;
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    const esp_pm_config_t *pm_config = config;
+
+    light_sleep_enabled = pm_config->light_sleep_enable;
+
+    ESP_LOGI(TAG, "cpu %d-%d mhz, automatic light sleep %s", pm_config->min_freq_mhz, pm_config->max_freq_mhz, light_sleep_enabled ? "on" : "off");
+
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    int index = atomic_fetch_add(&lock_count, 1);
+
+    if (index >= SIM_PM_MAX_LOCKS)
+    {
+        atomic_fetch_sub(&lock_count, 1);
+
+        return ESP_ERR_NO_MEM;
+    }
+
+    locks[index].name = name;
+    locks[index].type = lock_type;
+
+    *out_handle = &locks[index];
+
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    if (atomic_fetch_add(&handle->count, 1) == 0)
+    {
+        atomic_fetch_add(&held_locks, 1);
+    }
+
+    atomic_fetch_add(&handle->acquisitions, 1);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    int count = atomic_load(&handle->count);
+
+    do
+    {
+        if (count == 0)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    while (!atomic_compare_exchange_weak(&handle->count, &count, count - 1));
+
+    if (count == 1)
+    {
+        atomic_fetch_sub(&held_locks, 1);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_light_sleep_register_cbs(esp_pm_sleep_cbs_register_config_t *cbs_conf)
+{
+    exit_callback = cbs_conf->exit_cb;
+    exit_callback_arg = cbs_conf->exit_cb_user_arg;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_dump_locks(FILE *stream)
+{
+    fprintf(stream, "%-16s %-14s %-6s %s\n", "name", "type", "held", "acquisitions");
+
+    for (int i = 0; i < atomic_load(&lock_count) && i < SIM_PM_MAX_LOCKS; i++)
+    {
+        fprintf(stream, "%-16s %-14s %-6d %" PRIu32 "\n", locks[i].name, lock_type_names[locks[i].type], atomic_load(&locks[i].count), (uint32_t) atomic_load(&locks[i].acquisitions));
+    }
+
+    fprintf(stream, "light sleep %s\n", (light_sleep_enabled && atomic_load(&held_locks) == 0) ? "allowed" : "held off");
+
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup_io(uint64_t io_mask, esp_sleep_ext1_wakeup_mode_t level_mode)
+{
+    ext1_wakeup_mask |= io_mask;
+    ext1_wakeup_mode = level_mode;
+
+    return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void)
+{
+    return wakeup_cause;
+}
+
+void esp_deep_sleep_start(void)
+{
+    ESP_LOGI(TAG, "entering simulated deep sleep, restart the simulator to wake");
+
+    exit(0);
+}
+
+void sim_pm_pin_changed(gpio_num_t gpio_num, int level)
+{
+    // with no lock held the device would be light sleeping between ticks
+    if (!light_sleep_enabled || atomic_load(&held_locks) != 0 || !(ext1_wakeup_mask & BIT64(gpio_num)))
+    {
+        return;
+    }
+
+    if (level != (ext1_wakeup_mode == ESP_EXT1_WAKEUP_ANY_HIGH))
+    {
+        return;
+    }
+
+    ESP_LOGI(TAG, "woken from simulated light sleep by gpio %d", gpio_num);
+
+    wakeup_cause = ESP_SLEEP_WAKEUP_EXT1;
+
+    if (exit_callback != NULL)
+    {
+        exit_callback(0, exit_callback_arg);
+    }
+}
@@ -0,0 +1,79 @@
+#include "sim.h"
+
+#include "status/status.h"
+#include "status/pattern_driver_thread.h"
+#include "status/led_pattern.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "sim (render)";
+
+int run_sim_render(enum CurrentPattern pattern, int data, int64_t budget_ms)
+{
+    const char *pattern_name = get_led_pattern_name(pattern);
+    uint32_t nominal_ms = get_led_pattern_pass_time(pattern, data);
+
+    ESP_LOGI(TAG, "rendering %s pattern...", pattern_name);
+
+    int64_t previous_start_time = pattern_start_times[LED_STATUS_CHANNEL];
+    int64_t previous_pass_time = pattern_pass_times[LED_STATUS_CHANNEL];
+
+    set_current_pattern(LED_STATUS_CHANNEL, pattern, data);
+
+    int64_t deadline = esp_timer_get_time() + (int64_t) SIM_RENDER_TIMEOUT * 1000;
+
+    while (pattern_start_times[LED_STATUS_CHANNEL] == previous_start_time)
+    {
+        if (esp_timer_get_time() > deadline)
+        {
+            printf("render: the driver never started the pattern\n");
+            return -1;
+        }
+
+        vTaskDelay(1);
+    }
+
+    int64_t start_time = pattern_start_times[LED_STATUS_CHANNEL];
+
+    printf("time_ms,duty\n");
+
+    // one sample per tick, which is also the resolution the driver works at
+    while (pattern_pass_times[LED_STATUS_CHANNEL] == previous_pass_time || pattern_pass_times[LED_STATUS_CHANNEL] < start_time)
+    {
+        int64_t now = esp_timer_get_time();
+
+        if (now > deadline)
+        {
+            printf("render: %s pattern never finished a pass\n", pattern_name);
+            return -1;
+        }
+
+        printf("%" PRId64 ",%" PRIu32 "\n", (now - start_time) / 1000, sim_ledc_get_duty(LED_LS_MODE, led_channels[LED_STATUS_CHANNEL].channel));
+
+        vTaskDelay(1);
+    }
+
+    int64_t pass_ms = (pattern_pass_times[LED_STATUS_CHANNEL] - start_time) / 1000;
+
+    printf("%" PRId64 ",%" PRIu32 "\n", pass_ms, sim_ledc_get_duty(LED_LS_MODE, led_channels[LED_STATUS_CHANNEL].channel));
+
+    printf("render: %s pass took %" PRId64 " ms, %" PRIu32 " ms on paper (%+" PRId64 " ms)\n", pattern_name, pass_ms, nominal_ms, pass_ms - (int64_t) nominal_ms);
+
+    if (budget_ms > 0)
+    {
+        bool passed = pass_ms <= budget_ms;
+
+        printf("render: budget %" PRId64 " ms: %s\n", budget_ms, passed ? "PASS" : "FAIL");
+
+        return passed ? 0 : 1;
+    }
+
+    return 0;
+}
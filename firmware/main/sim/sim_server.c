@@ -0,0 +1,327 @@
+#include "sim.h"
+
+#include "latency/latency.h"
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+// stand-in for wss://api.purduehackers.com/doorbell: answers a "true" ring with "t", then "f" once the ring is over
+//
+// this runs on a plain pthread rather than a FreeRTOS task so blocking socket calls can't stall the
+// simulated scheduler, which also means it must never call into FreeRTOS
+
+#define WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define WEBSOCKET_OPCODE_TEXT   0x1
+#define WEBSOCKET_OPCODE_CLOSE  0x8
+#define WEBSOCKET_OPCODE_PING   0x9
+#define WEBSOCKET_OPCODE_PONG   0xa
+
+static const char *TAG = "sim (server)";
+
+static pthread_t server_thread;
+
+static atomic_uint arrivals;
+static atomic_int ring_time = SIM_SERVER_RING_TIME;
+
+static bool read_exact(int fd, void *buffer, size_t length)
+{
+    uint8_t *cursor = buffer;
+
+    while (length > 0)
+    {
+        ssize_t received = recv(fd, cursor, length, 0);
+
+        if (received <= 0)
+        {
+            return false;
+        }
+
+        cursor += received;
+        length -= received;
+    }
+
+    return true;
+}
+
+static bool send_frame(int fd, uint8_t opcode, const uint8_t *payload, size_t length)
+{
+    uint8_t header[4];
+    size_t header_length;
+
+    if (length > 0xffff)
+    {
+        return false;
+    }
+
+    // server frames are never masked
+    header[0] = 0x80 | opcode;
+
+    if (length < 126)
+    {
+        header[1] = length;
+        header_length = 2;
+    }
+    else
+    {
+        header[1] = 126;
+        header[2] = length >> 8;
+        header[3] = length & 0xff;
+        header_length = 4;
+    }
+
+    if (send(fd, header, header_length, 0) != header_length)
+    {
+        return false;
+    }
+
+    return length == 0 || send(fd, payload, length, 0) == length;
+}
+
+static bool handshake(int fd)
+{
+    char request[SIM_SERVER_MAX_REQUEST + 1];
+    size_t request_length = 0;
+
+    while (request_length < SIM_SERVER_MAX_REQUEST)
+    {
+        ssize_t received = recv(fd, request + request_length, SIM_SERVER_MAX_REQUEST - request_length, 0);
+
+        if (received <= 0)
+        {
+            return false;
+        }
+
+        request_length += received;
+        request[request_length] = '\0';
+
+        if (strstr(request, "\r\n\r\n") != NULL)
+        {
+            break;
+        }
+    }
+
+    char *key = strcasestr(request, "Sec-WebSocket-Key:");
+
+    if (key == NULL)
+    {
+        ESP_LOGW(TAG, "upgrade request without a key");
+
+        return false;
+    }
+
+    key += strlen("Sec-WebSocket-Key:");
+    key += strspn(key, " ");
+    key[strcspn(key, "\r\n ")] = '\0';
+
+    char accept_source[128];
+    uint8_t accept_hash[20];
+    unsigned char accept[32];
+    size_t accept_length;
+
+    snprintf(accept_source, sizeof(accept_source), "%s" WEBSOCKET_GUID, key);
+    mbedtls_sha1((const unsigned char *) accept_source, strlen(accept_source), accept_hash);
+    mbedtls_base64_encode(accept, sizeof(accept), &accept_length, accept_hash, sizeof(accept_hash));
+
+    char response[256];
+    int response_length = snprintf(
+        response,
+        sizeof(response),
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: %.*s\r\n\r\n",
+        (int) accept_length,
+        accept
+    );
+
+    return send(fd, response, response_length, 0) == response_length;
+}
+
+static void serve(int fd)
+{
+    uint8_t payload[SIM_SERVER_MAX_PAYLOAD];
+
+    while (1)
+    {
+        uint8_t header[2];
+
+        if (!read_exact(fd, header, sizeof(header)))
+        {
+            return;
+        }
+
+        uint8_t opcode = header[0] & 0x0f;
+        bool masked = header[1] & 0x80;
+        uint64_t length = header[1] & 0x7f;
+
+        if (length == 126)
+        {
+            uint8_t extended[2];
+
+            if (!read_exact(fd, extended, sizeof(extended)))
+            {
+                return;
+            }
+
+            length = (extended[0] << 8) | extended[1];
+        }
+        else if (length == 127)
+        {
+            uint8_t extended[8];
+
+            if (!read_exact(fd, extended, sizeof(extended)))
+            {
+                return;
+            }
+
+            length = 0;
+
+            for (int i = 0; i < 8; i++)
+            {
+                length = (length << 8) | extended[i];
+            }
+        }
+
+        uint8_t mask[4] = { 0 };
+
+        if (masked && !read_exact(fd, mask, sizeof(mask)))
+        {
+            return;
+        }
+
+        if (length > sizeof(payload))
+        {
+            ESP_LOGW(TAG, "frame too large, dropping client");
+
+            return;
+        }
+
+        if (!read_exact(fd, payload, length))
+        {
+            return;
+        }
+
+        int64_t arrival = esp_timer_get_time();
+
+        for (uint64_t i = 0; i < length; i++)
+        {
+            payload[i] ^= mask[i % 4];
+        }
+
+        if (opcode == WEBSOCKET_OPCODE_TEXT)
+        {
+            if (length == 4 && memcmp(payload, "true", 4) == 0)
+            {
+                latency_mark_at(LatencyStage_ServerArrival, arrival);
+                atomic_fetch_add(&arrivals, 1);
+
+                send_frame(fd, WEBSOCKET_OPCODE_TEXT, (const uint8_t *) "t", 1);
+
+                int ring_time_ms = atomic_load(&ring_time);
+
+                if (ring_time_ms > 0)
+                {
+                    usleep(ring_time_ms * 1000);
+                }
+
+                send_frame(fd, WEBSOCKET_OPCODE_TEXT, (const uint8_t *) "f", 1);
+            }
+        }
+        else if (opcode == WEBSOCKET_OPCODE_PING)
+        {
+            send_frame(fd, WEBSOCKET_OPCODE_PONG, payload, length);
+        }
+        else if (opcode == WEBSOCKET_OPCODE_CLOSE)
+        {
+            send_frame(fd, WEBSOCKET_OPCODE_CLOSE, payload, length);
+
+            return;
+        }
+    }
+}
+
+static void *server_thread_entrypoint(void *arg)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+
+    int enable = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(SIM_SERVER_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    if (bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listener, 1) != 0)
+    {
+        ESP_LOGE(TAG, "could not listen on port %d", SIM_SERVER_PORT);
+
+        close(listener);
+
+        return NULL;
+    }
+
+    while (1)
+    {
+        int client = accept(listener, NULL, NULL);
+
+        if (client < 0)
+        {
+            continue;
+        }
+
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        if (handshake(client))
+        {
+            serve(client);
+        }
+
+        close(client);
+    }
+
+    return NULL;
+}
+
+void start_sim_server()
+{
+    ESP_LOGI(TAG, "starting websocket stand-in on 127.0.0.1:%d...", SIM_SERVER_PORT);
+
+    // keep the simulated tick signal away from this thread
+    sigset_t all_signals;
+    sigset_t previous_signals;
+
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous_signals);
+
+    pthread_create(&server_thread, NULL, server_thread_entrypoint, NULL);
+
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+}
+
+void sim_server_set_ring_time(int ring_time_ms)
+{
+    atomic_store(&ring_time, ring_time_ms);
+}
+
+uint32_t sim_server_arrivals()
+{
+    return atomic_load(&arrivals);
+}
@@ -0,0 +1,245 @@
+#include "sim.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+
+#include "esp_wifi.h"
+#include "esp_eap_client.h"
+#include "esp_event.h"
+#include "esp_log.h"
+
+static const char *TAG = "sim (wifi)";
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+enum SimWifiState {
+    SimWifiState_Stopped = 0,
+    SimWifiState_Idle = 1,
+    SimWifiState_Associating = 2,
+    SimWifiState_Associated = 3,
+    SimWifiState_GotIp = 4,
+};
+
+static enum SimWifiState wifi_state;
+static bool access_point_available = true;
+
+static const uint8_t access_point_bssid[6] = SIM_WIFI_BSSID;
+static wifi_sta_config_t sta_config;
+
+static TimerHandle_t wifi_step_timer;
+
+static void post_wifi_event(esp_event_base_t event_base, int32_t event_id, void *event_data, size_t event_data_size)
+{
+    if (esp_event_post(event_base, event_id, event_data, event_data_size, 0) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "dropped simulated event %" PRId32, event_id);
+    }
+}
+
+static void post_got_ip()
+{
+    // the loopback address, so the socket can reach a server on the host
+    ip_event_got_ip_t event = {
+        .if_index = 0,
+        .ip_info = {
+            .ip = { .addr = 0x0100007f },
+            .netmask = { .addr = 0x000000ff },
+            .gw = { .addr = 0x0100007f },
+        },
+        .ip_changed = true,
+    };
+
+    post_wifi_event(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event));
+}
+
+static void wifi_step_timer_expired_callback(TimerHandle_t expired_wifi_step_timer)
+{
+    if (wifi_state == SimWifiState_Associating)
+    {
+        bool directed_at_other_ap = sta_config.bssid_set && memcmp(sta_config.bssid, access_point_bssid, sizeof(access_point_bssid)) != 0;
+
+        if (!access_point_available || directed_at_other_ap)
+        {
+            wifi_state = SimWifiState_Idle;
+            post_wifi_event(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, NULL, 0);
+
+            return;
+        }
+
+        wifi_state = SimWifiState_Associated;
+        post_wifi_event(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, NULL, 0);
+
+        xTimerChangePeriod(wifi_step_timer, pdMS_TO_TICKS(SIM_WIFI_DHCP_TIME), 0);
+    }
+    else if (wifi_state == SimWifiState_Associated)
+    {
+        wifi_state = SimWifiState_GotIp;
+        post_got_ip();
+    }
+}
+
+void sim_wifi_set_available(bool available)
+{
+    access_point_available = available;
+
+    if (!available && (wifi_state == SimWifiState_Associated || wifi_state == SimWifiState_GotIp))
+    {
+        xTimerStop(wifi_step_timer, portMAX_DELAY);
+
+        wifi_state = SimWifiState_Idle;
+        post_wifi_event(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, NULL, 0);
+    }
+}
+
+void sim_wifi_lose_ip()
+{
+    if (wifi_state == SimWifiState_GotIp)
+    {
+        wifi_state = SimWifiState_Associated;
+        post_wifi_event(IP_EVENT, IP_EVENT_STA_LOST_IP, NULL, 0);
+
+        xTimerChangePeriod(wifi_step_timer, pdMS_TO_TICKS(SIM_WIFI_DHCP_TIME), portMAX_DELAY);
+    }
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    return NULL;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    wifi_step_timer = xTimerCreate(
+        "sim wifi step",
+        pdMS_TO_TICKS(SIM_WIFI_ASSOCIATE_TIME),
+        pdFALSE,
+        (void *) 0,
+        wifi_step_timer_expired_callback
+    );
+
+    wifi_state = SimWifiState_Stopped;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    sta_config = conf->sta;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    if (wifi_state != SimWifiState_Stopped)
+    {
+        return ESP_OK;
+    }
+
+    wifi_state = SimWifiState_Idle;
+    post_wifi_event(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    if (wifi_state == SimWifiState_Stopped)
+    {
+        return ESP_OK;
+    }
+
+    xTimerStop(wifi_step_timer, portMAX_DELAY);
+
+    wifi_state = SimWifiState_Stopped;
+    post_wifi_event(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    if (wifi_state != SimWifiState_Idle)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    wifi_state = SimWifiState_Associating;
+
+    int join_time = SIM_WIFI_ASSOCIATE_TIME;
+
+    if (!sta_config.bssid_set || sta_config.channel == 0)
+    {
+        join_time += SIM_WIFI_SCAN_TIME;
+    }
+
+    xTimerChangePeriod(wifi_step_timer, pdMS_TO_TICKS(join_time), portMAX_DELAY);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    if (wifi_state != SimWifiState_Associated && wifi_state != SimWifiState_GotIp)
+    {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+
+    *ap_info = (wifi_ap_record_t) {
+        .primary = SIM_WIFI_CHANNEL,
+        .rssi = -40,
+    };
+    memcpy(ap_info->bssid, access_point_bssid, sizeof(access_point_bssid));
+
+    return ESP_OK;
+}
+
+esp_err_t esp_eap_client_set_identity(const unsigned char *identity, int len)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_eap_client_set_username(const unsigned char *username, int len)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_eap_client_set_password(const unsigned char *password, int len)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_eap_client_set_domain_name(const char *domain_name)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_enterprise_enable(void)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,65 @@
+#include "led_curve.h"
+
+#include "status.h"
+
+// cie 1931 lightness (0 - 100) to relative luminance, which is what duty controls
+#define CIE_LUMINANCE(l) ((l) <= 8.0 ? (l) / 903.3 : (((l) + 16.0) / 116.0) * (((l) + 16.0) / 116.0) * (((l) + 16.0) / 116.0))
+
+#define CURVE_DUTY(i) ((uint16_t) (CIE_LUMINANCE(100.0 * (i) / (LED_CURVE_POINTS - 1)) * LED_MAX_DUTY + 0.5))
+
+// folded to constants by the compiler, nothing is computed at runtime
+static const uint16_t led_curve[LED_CURVE_POINTS] = {
+    CURVE_DUTY(0),
+    CURVE_DUTY(1),
+    CURVE_DUTY(2),
+    CURVE_DUTY(3),
+    CURVE_DUTY(4),
+    CURVE_DUTY(5),
+    CURVE_DUTY(6),
+    CURVE_DUTY(7),
+    CURVE_DUTY(8),
+    CURVE_DUTY(9),
+    CURVE_DUTY(10),
+    CURVE_DUTY(11),
+    CURVE_DUTY(12),
+    CURVE_DUTY(13),
+    CURVE_DUTY(14),
+    CURVE_DUTY(15),
+    CURVE_DUTY(16),
+    CURVE_DUTY(17),
+    CURVE_DUTY(18),
+    CURVE_DUTY(19),
+    CURVE_DUTY(20),
+    CURVE_DUTY(21),
+    CURVE_DUTY(22),
+    CURVE_DUTY(23),
+    CURVE_DUTY(24),
+    CURVE_DUTY(25),
+    CURVE_DUTY(26),
+    CURVE_DUTY(27),
+    CURVE_DUTY(28),
+    CURVE_DUTY(29),
+    CURVE_DUTY(30),
+    CURVE_DUTY(31),
+    CURVE_DUTY(32),
+};
+
+_Static_assert(sizeof(led_curve) / sizeof(led_curve[0]) == LED_CURVE_POINTS, "led curve doesn't cover every point");
+
+uint32_t led_brightness_to_duty(int brightness)
+{
+    if (brightness <= 0)
+    {
+        return 0;
+    }
+    if (brightness >= LED_MAX_BRIGHTNESS)
+    {
+        return LED_MAX_DUTY;
+    }
+
+    int position = brightness * (LED_CURVE_POINTS - 1);
+    int point = position / LED_MAX_BRIGHTNESS;
+    int remainder = position % LED_MAX_BRIGHTNESS;
+
+    return led_curve[point] + ((led_curve[point + 1] - led_curve[point]) * remainder) / LED_MAX_BRIGHTNESS;
+}
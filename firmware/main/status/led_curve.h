@@ -0,0 +1,12 @@
+#ifndef LED_CURVE_H
+#define LED_CURVE_H
+
+#include <stdint.h>
+
+// brightness steps the table is sampled at, brightness in between is interpolated
+#define LED_CURVE_POINTS 33
+
+// perceived brightness (0 - LED_MAX_BRIGHTNESS) to the duty that looks that bright
+uint32_t led_brightness_to_duty(int brightness);
+
+#endif
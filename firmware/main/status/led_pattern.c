@@ -0,0 +1,125 @@
+#include "led_pattern.h"
+
+#include "status.h"
+
+#define COUNT_OF(array) ((int) (sizeof(array) / sizeof((array)[0])))
+
+static const struct LedKeyframe starting_up_keyframes[] = {
+    { LED_KEYFRAME_CURRENT_BRIGHTNESS, LED_INDICATE_BRIGHTNESS, LED_TEST_FADE_TIME, 0 },
+};
+
+static const struct LedKeyframe off_keyframes[] = {
+    { LED_KEYFRAME_CURRENT_BRIGHTNESS, 0, LED_TEST_FADE_TIME, 0 },
+};
+
+static const struct LedKeyframe wifi_disconnected_keyframes[] = {
+    { LED_MAX_BRIGHTNESS, LED_MEDIUM_BRIGHTNESS, WIFI_DISCONNECTED_SHORT_TIME, 0 },
+    { LED_MAX_BRIGHTNESS, 0, WIFI_DISCONNECTED_LONG_TIME, 0 },
+};
+
+static const struct LedKeyframe updating_keyframes[] = {
+    { LED_MAX_BRIGHTNESS, 0, UPDATING_FADE_TIME, 0 },
+};
+
+static const struct LedKeyframe ringing_ringing_keyframes[] = {
+    { LED_KEYFRAME_CURRENT_BRIGHTNESS, LED_MAX_BRIGHTNESS, RINGING_FADE_TIME, 0 },
+};
+
+static const struct LedKeyframe ringing_sending_keyframes[] = {
+    { LED_KEYFRAME_CURRENT_BRIGHTNESS, LED_MAX_BRIGHTNESS, RINGING_FADE_TIME, 0 },
+    { LED_KEYFRAME_CURRENT_BRIGHTNESS, LED_MEDIUM_BRIGHTNESS, RINGING_FADE_TIME, 0 },
+};
+
+static struct LedKeyframe error_keyframes[ERROR_KEYFRAME_COUNT];
+
+static const struct LedPattern led_patterns[] = {
+    { "starting up", starting_up_keyframes, COUNT_OF(starting_up_keyframes), LED_PATTERN_NO_LOOP, false },
+    { "off", off_keyframes, COUNT_OF(off_keyframes), LED_PATTERN_NO_LOOP, false },
+    { "error", error_keyframes, ERROR_KEYFRAME_COUNT, LED_PATTERN_NO_LOOP, true },
+    { "wifi disconnected", wifi_disconnected_keyframes, COUNT_OF(wifi_disconnected_keyframes), 0, false },
+    { "updating", updating_keyframes, COUNT_OF(updating_keyframes), 0, false },
+    { "ringing", ringing_ringing_keyframes, COUNT_OF(ringing_ringing_keyframes), LED_PATTERN_NO_LOOP, false },
+    { "ringing sending", ringing_sending_keyframes, COUNT_OF(ringing_sending_keyframes), 0, false },
+};
+
+static int set_error_keyframe(struct LedKeyframe *keyframes, int index, uint32_t brightness)
+{
+    keyframes[index] = (struct LedKeyframe) { LED_KEYFRAME_CURRENT_BRIGHTNESS, brightness, 0, ERROR_HOLD_TIME };
+
+    return index + 1;
+}
+
+static void build_error_keyframes(struct LedKeyframe *keyframes, int error)
+{
+    int index = 0;
+
+    // off, full, off, medium, off marks the start of a code
+    index = set_error_keyframe(keyframes, index, 0);
+    index = set_error_keyframe(keyframes, index, LED_MAX_BRIGHTNESS);
+    index = set_error_keyframe(keyframes, index, 0);
+    index = set_error_keyframe(keyframes, index, LED_MEDIUM_BRIGHTNESS);
+    index = set_error_keyframe(keyframes, index, 0);
+
+    // msb first, full for a 1 and medium for a 0
+    for (int i = ERROR_MAX_BITS - 1; i >= 0; i--)
+    {
+        index = set_error_keyframe(keyframes, index, ((error >> i) & 1) ? LED_MAX_BRIGHTNESS : LED_MEDIUM_BRIGHTNESS);
+        index = set_error_keyframe(keyframes, index, 0);
+    }
+
+    index = set_error_keyframe(keyframes, index, LED_MEDIUM_BRIGHTNESS);
+
+    keyframes[index] = (struct LedKeyframe) { LED_KEYFRAME_CURRENT_BRIGHTNESS, 0, ERROR_HOLD_TIME, 0 };
+}
+
+static const struct LedPattern *find_led_pattern(enum CurrentPattern pattern)
+{
+    // the enum starts at CurrentPattern_StartingUp = -1
+    int index = pattern - CurrentPattern_StartingUp;
+
+    if (index < 0 || index >= COUNT_OF(led_patterns))
+    {
+        return &led_patterns[CurrentPattern_Off - CurrentPattern_StartingUp];
+    }
+
+    return &led_patterns[index];
+}
+
+const struct LedPattern *get_led_pattern(enum CurrentPattern pattern, int data)
+{
+    if (pattern == CurrentPattern_Error)
+    {
+        build_error_keyframes(error_keyframes, data);
+    }
+
+    return find_led_pattern(pattern);
+}
+
+const char *get_led_pattern_name(enum CurrentPattern pattern)
+{
+    return find_led_pattern(pattern)->name;
+}
+
+uint32_t get_led_pattern_pass_time(enum CurrentPattern pattern, int data)
+{
+    const struct LedPattern *led_pattern = find_led_pattern(pattern);
+    const struct LedKeyframe *keyframes = led_pattern->keyframes;
+
+    // built into our own copy, the shared one may be playing right now
+    struct LedKeyframe built_error_keyframes[ERROR_KEYFRAME_COUNT];
+
+    if (pattern == CurrentPattern_Error)
+    {
+        build_error_keyframes(built_error_keyframes, data);
+        keyframes = built_error_keyframes;
+    }
+
+    uint32_t pass_time = 0;
+
+    for (int i = 0; i < led_pattern->keyframe_count; i++)
+    {
+        pass_time += keyframes[i].fade_time + keyframes[i].hold_time;
+    }
+
+    return pass_time;
+}
@@ -0,0 +1,48 @@
+#ifndef LED_PATTERN_H
+#define LED_PATTERN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "status.h"
+#include "pattern_driver_thread.h"
+
+// the keyframe fades from wherever the led currently is
+#define LED_KEYFRAME_CURRENT_BRIGHTNESS -1
+
+// the pattern stays on its last keyframe instead of looping
+#define LED_PATTERN_NO_LOOP         -1
+
+// 5 keyframe header, an on/off pair per bit, then the trailing bar and fade out
+#define ERROR_KEYFRAME_COUNT        (5 + (ERROR_MAX_BITS * 2) + 2)
+
+struct LedKeyframe {
+    // jumped to before the fade starts, or LED_KEYFRAME_CURRENT_BRIGHTNESS
+    int32_t start_brightness;
+    // perceived, see LED_MAX_BRIGHTNESS
+    uint32_t brightness;
+    // ms, 0 jumps straight to brightness
+    uint32_t fade_time;
+    // ms to stay on brightness once it's reached
+    uint32_t hold_time;
+};
+
+struct LedPattern {
+    const char *name;
+    const struct LedKeyframe *keyframes;
+    int keyframe_count;
+    // keyframe to jump back to after the last one, or LED_PATTERN_NO_LOOP
+    int loop_start;
+    // reports CURRENT_PATTERN_COMPLETE if it plays out without being replaced
+    bool reports_complete;
+};
+
+// the error pattern is built into a shared buffer, only the driver thread may call this
+const struct LedPattern *get_led_pattern(enum CurrentPattern pattern, int data);
+
+// safe from any task, neither touches the pattern the driver is playing
+const char *get_led_pattern_name(enum CurrentPattern pattern);
+// ms one pass through every keyframe takes on paper, ignoring tick rounding
+uint32_t get_led_pattern_pass_time(enum CurrentPattern pattern, int data);
+
+#endif
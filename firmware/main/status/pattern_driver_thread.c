@@ -1,399 +1,362 @@
 #include "pattern_driver_thread.h"
 
 #include "status.h"
+#include "status_sync_thread.h"
+#include "led_pattern.h"
+#include "led_curve.h"
+#include "trace/trace.h"
+#include "main.h"
 
 #include <unistd.h>
 #include <pthread.h>
+#include <stdlib.h>
 #include <inttypes.h>
 
 #include "freertos/idf_additions.h"
 #include "freertos/task.h"
 
 #include "driver/ledc.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 
 static const char *TAG = "status (led pattern driver thread)";
 
-enum CurrentPattern current_pattern;
-int current_pattern_data;
+atomic_uint_least32_t current_pattern_states[LED_CHANNEL_COUNT];
 
-SemaphoreHandle_t current_pattern_semaphore;
 EventGroupHandle_t current_pattern_events;
 
-void led_pattern_driver_thread_entrypoint(void * arg)
+atomic_int completed_pattern_data;
+
+volatile int64_t pattern_start_times[LED_CHANNEL_COUNT];
+volatile int64_t pattern_pass_times[LED_CHANNEL_COUNT];
+
+TaskHandle_t led_pattern_driver_thread_handle;
+
+// one per led channel, they only share the driver thread
+struct LedPatternPlayer {
+    int channel;
+    const ledc_channel_config_t *led;
+    enum CurrentPattern current;
+    int data;
+    const struct LedPattern *pattern;
+    int keyframe;
+    // the keyframe's fade runs as segment_count hardware fades along the brightness curve
+    int fade_from;
+    int fade_to;
+    uint32_t fade_time;
+    int segment;
+    int segment_count;
+    // target of the last fade or jump, where a keyframe without a start brightness begins
+    int brightness;
+    // waiting on the fade end event for the current segment
+    bool fading;
+    // on the last keyframe of a pattern that doesn't loop
+    bool finished;
+    TickType_t hold_start;
+    TickType_t hold_ticks;
+};
+
+// wakeups since the last pattern change, and how many of them found nothing to do
+static uint32_t driver_wakeups;
+static uint32_t driver_idle_wakeups;
+
+void set_current_pattern(int channel, enum CurrentPattern pattern, int data)
+{
+    atomic_store(&current_pattern_states[channel], ((uint32_t) data << 8) | (uint8_t) pattern);
+
+    xTaskNotify(led_pattern_driver_thread_handle, LED_NOTIFY_PATTERN_UPDATED(channel), eSetBits);
+}
+
+void get_current_pattern(int channel, enum CurrentPattern *pattern, int *data)
+{
+    uint32_t state = atomic_load(&current_pattern_states[channel]);
+
+    *pattern = (int8_t) (state & 0xff);
+    *data = state >> 8;
+}
+
+// the fade end interrupt can't wake us from light sleep, so only fades keep us up. holds are tick timeouts,
+// and the led itself keeps running through light sleep
+static void set_player_fading(struct LedPatternPlayer *player, bool fading)
+{
+    if (fading == player->fading)
+    {
+        return;
+    }
+
+    if (fading)
+    {
+        take_sleep_inhibit(SleepInhibit_LedAnimation);
+    }
+    else
+    {
+        return_sleep_inhibit(SleepInhibit_LedAnimation);
+    }
+
+    player->fading = fading;
+}
+
+static void set_led_duty(struct LedPatternPlayer *player, uint32_t duty)
+{
+    ledc_set_duty(player->led->speed_mode, player->led->channel, duty);
+    ledc_update_duty(player->led->speed_mode, player->led->channel);
+}
+
+// each segment is a linear hardware fade between two points on the curve, so the cpu only steps in once per segment
+static void start_fade_segment(struct LedPatternPlayer *player)
 {
-    enum CurrentPattern current_pattern_internal = -1;
-    int current_pattern_data_internal = 0;
-    int current_pattern_progress = 0;
+    int segment_end = player->segment + 1;
 
-    ESP_LOGI(TAG, "running led fade in...");
+    int brightness = player->fade_from + (player->fade_to - player->fade_from) * segment_end / player->segment_count;
+    uint32_t segment_time = player->fade_time * segment_end / player->segment_count - player->fade_time * player->segment / player->segment_count;
 
     ledc_set_fade_with_time(
-        led_channel.speed_mode,
-        led_channel.channel,
-        LED_INDICATE_DUTY,
-        LED_TEST_FADE_TIME
+        player->led->speed_mode,
+        player->led->channel,
+        led_brightness_to_duty(brightness),
+        segment_time
     );
     ledc_fade_start(
-        led_channel.speed_mode,
-        led_channel.channel,
+        player->led->speed_mode,
+        player->led->channel,
         LEDC_FADE_NO_WAIT
     );
 
-    xSemaphoreTake(fade_complete_semaphore, portMAX_DELAY);
+    player->brightness = brightness;
+    set_player_fading(player, true);
+}
 
-    ESP_LOGI(TAG, "led fade in done...");
+static void start_keyframe(struct LedPatternPlayer *player, int keyframe_index)
+{
+    const struct LedKeyframe *keyframe = &player->pattern->keyframes[keyframe_index];
 
-    ESP_LOGI(TAG, "waiting for system ready pattern...");
+    player->keyframe = keyframe_index;
+    player->hold_ticks = keyframe->hold_time / portTICK_PERIOD_MS;
 
-    while (1)
+    if (keyframe->fade_time == 0)
+    {
+        set_led_duty(player, led_brightness_to_duty(keyframe->brightness));
+
+        player->brightness = keyframe->brightness;
+        set_player_fading(player, false);
+        player->hold_start = xTaskGetTickCount();
+
+        return;
+    }
+
+    if (keyframe->start_brightness != LED_KEYFRAME_CURRENT_BRIGHTNESS)
+    {
+        set_led_duty(player, led_brightness_to_duty(keyframe->start_brightness));
+
+        player->brightness = keyframe->start_brightness;
+
+        // shorter than a tick, usleep busy waits it instead of rounding it down to no wait at all
+        usleep(LED_SAFE_PWM_CYCLE_DELAY * 1000);
+    }
+
+    int distance = abs((int) keyframe->brightness - player->brightness);
+
+    player->fade_from = player->brightness;
+    player->fade_to = keyframe->brightness;
+    player->fade_time = keyframe->fade_time;
+    player->segment = 0;
+    player->segment_count = (distance * LED_FADE_SEGMENTS + LED_MAX_BRIGHTNESS - 1) / LED_MAX_BRIGHTNESS;
+
+    if (player->segment_count < 1)
+    {
+        player->segment_count = 1;
+    }
+
+    start_fade_segment(player);
+}
+
+static void start_pattern(struct LedPatternPlayer *player, enum CurrentPattern current, int data)
+{
+    const struct LedPattern *pattern = get_led_pattern(current, data);
+
+    trace(TraceEvent_DriverWakeups, driver_wakeups, driver_idle_wakeups);
+    trace(TraceEvent_PatternStart, player->channel, (uint32_t) current | ((uint32_t) data << 8));
+
+    driver_wakeups = 0;
+    driver_idle_wakeups = 0;
+
+    ledc_fade_stop(player->led->speed_mode, player->led->channel);
+
+    // a fade end from the pattern we just cut off would skip our first keyframe
+    ulTaskNotifyValueClear(NULL, LED_NOTIFY_FADE_END(player->channel));
+
+    player->current = current;
+    player->data = data;
+    player->pattern = pattern;
+    player->finished = false;
+
+    start_keyframe(player, 0);
+
+    pattern_start_times[player->channel] = esp_timer_get_time();
+}
+
+static void finish_pattern(struct LedPatternPlayer *player)
+{
+    trace(TraceEvent_PatternFinished, player->channel, player->current);
+
+    player->finished = true;
+
+    if (!player->pattern->reports_complete)
+    {
+        return;
+    }
+
+    atomic_store(&completed_pattern_data, player->data);
+
+    // it leaves the led off, setting the same pattern again has to replay it
+    player->current = CurrentPattern_Off;
+    player->data = 0;
+
+    xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_COMPLETE);
+
+    // the sync thread decides what follows it
+    xEventGroupSetBits(status_state_events, STATUS_STATE_UPDATED);
+}
+
+// ticks until the player needs to run again without being notified, fades and finished patterns only move on events
+static TickType_t pattern_wait_ticks(struct LedPatternPlayer *player)
+{
+    if (player->finished || player->fading)
+    {
+        return portMAX_DELAY;
+    }
+
+    TickType_t held = xTaskGetTickCount() - player->hold_start;
+
+    return (held >= player->hold_ticks) ? 0 : player->hold_ticks - held;
+}
+
+// returns whether the player moved on to another fade segment or keyframe
+static bool advance_pattern(struct LedPatternPlayer *player, bool fade_ended)
+{
+    if (player->finished)
     {
-        if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
+        return false;
+    }
+
+    if (player->fading)
+    {
+        if (!fade_ended)
         {
-            if (current_pattern == CurrentPattern_StartingUp)
-            {
-                xSemaphoreGive(current_pattern_semaphore);
-                xEventGroupWaitBits(current_pattern_events, CURRENT_PATTERN_UPDATED, pdFALSE, pdFALSE, portMAX_DELAY);
-            }
-            else
-            {
-                current_pattern_internal = 0;
-                xSemaphoreGive(current_pattern_semaphore);
-                break;
-            }
+            return false;
         }
-        else
+
+        player->segment++;
+
+        if (player->segment < player->segment_count)
         {
-            vTaskDelay(2 / portTICK_PERIOD_MS);
+            start_fade_segment(player);
+
+            return true;
         }
-    }
 
-    ESP_LOGI(TAG, "running led fade out...");
+        set_player_fading(player, false);
+        player->hold_start = xTaskGetTickCount();
+    }
 
-    ledc_set_fade_with_time(
-        led_channel.speed_mode,
-        led_channel.channel,
-        0,
-        LED_TEST_FADE_TIME
-    );
-    ledc_fade_start(
-        led_channel.speed_mode,
-        led_channel.channel,
-        LEDC_FADE_NO_WAIT
-    );
+    if (pattern_wait_ticks(player) > 0)
+    {
+        return false;
+    }
 
-    xSemaphoreTake(fade_complete_semaphore, portMAX_DELAY);
+    int next_keyframe = player->keyframe + 1;
 
-    while (1)
+    if (next_keyframe >= player->pattern->keyframe_count)
     {
-        if (xSemaphoreTake(fade_complete_semaphore, 0))
+        pattern_pass_times[player->channel] = esp_timer_get_time();
+
+        if (player->pattern->loop_start == LED_PATTERN_NO_LOOP)
         {
-            ESP_LOGI(TAG, "fade complete event triggered");
+            finish_pattern(player);
 
-            if (current_pattern_internal == CurrentPattern_WifiDisconnected)
-            {
-                ESP_LOGI(TAG, "next step in the wifi pattern: %d", current_pattern_progress);
+            return true;
+        }
 
-                if (current_pattern_progress == 0)
-                {
-                    ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MAX_DUTY);
-                    ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-
-                    vTaskDelay(LED_SAFE_PWM_CYCLE_DELAY / portTICK_PERIOD_MS);
-
-                    ledc_set_fade_with_time(
-                        led_channel.speed_mode,
-                        led_channel.channel,
-                        LED_MEDIUM_DUTY,
-                        WIFI_DISCONNECTED_SHORT_TIME
-                    );
-                    ledc_fade_start(
-                        led_channel.speed_mode,
-                        led_channel.channel,
-                        LEDC_FADE_NO_WAIT
-                    );
-                }
-                else
-                {
-                    ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MAX_DUTY);
-                    ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-
-                    vTaskDelay(LED_SAFE_PWM_CYCLE_DELAY / portTICK_PERIOD_MS);
-
-                    ledc_set_fade_with_time(
-                        led_channel.speed_mode,
-                        led_channel.channel,
-                        0,
-                        WIFI_DISCONNECTED_LONG_TIME
-                    );
-                    ledc_fade_start(
-                        led_channel.speed_mode,
-                        led_channel.channel,
-                        LEDC_FADE_NO_WAIT
-                    );
-                }
+        next_keyframe = player->pattern->loop_start;
+    }
 
-                current_pattern_progress = (current_pattern_progress + 1) % 2;
-            }
-            else if (current_pattern_internal == CurrentPattern_Updating)
-            {
-                current_pattern_progress = 0;
-
-                ESP_LOGI(TAG, "flashing update pattern");
-
-                ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MAX_DUTY);
-                ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-
-                vTaskDelay(LED_SAFE_PWM_CYCLE_DELAY / portTICK_PERIOD_MS);
-
-                ledc_set_fade_with_time(
-                    led_channel.speed_mode,
-                    led_channel.channel,
-                    0,
-                    UPDATING_FADE_TIME
-                );
-                ledc_fade_start(
-                    led_channel.speed_mode,
-                    led_channel.channel,
-                    LEDC_FADE_NO_WAIT
-                );
-            }
-            else if (current_pattern_internal == CurrentPattern_Ringing_Ringing)
-            {
-                ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MAX_DUTY);
-                ledc_update_duty(led_channel.speed_mode, led_channel.channel);
+    start_keyframe(player, next_keyframe);
 
-                vTaskDelay(LED_SAFE_PWM_CYCLE_DELAY / portTICK_PERIOD_MS);
-            }
-            else if (current_pattern_internal == CurrentPattern_Ringing_Sending)
-            {
-                ESP_LOGI(TAG, "next step in the ringing sending pattern: %d", current_pattern_progress);
+    return true;
+}
 
-                if (current_pattern_progress == 0)
-                {
-                    ledc_set_fade_with_time(
-                        led_channel.speed_mode,
-                        led_channel.channel,
-                        LED_MAX_DUTY,
-                        RINGING_FADE_TIME
-                    );
-                    ledc_fade_start(
-                        led_channel.speed_mode,
-                        led_channel.channel,
-                        LEDC_FADE_NO_WAIT
-                    );
-                }
-                else
-                {
-                    ledc_set_fade_with_time(
-                        led_channel.speed_mode,
-                        led_channel.channel,
-                        LED_MEDIUM_DUTY,
-                        RINGING_FADE_TIME
-                    );
-                    ledc_fade_start(
-                        led_channel.speed_mode,
-                        led_channel.channel,
-                        LEDC_FADE_NO_WAIT
-                    );
-                }
+void led_pattern_driver_thread_entrypoint(void * arg)
+{
+    struct LedPatternPlayer players[LED_CHANNEL_COUNT] = { 0 };
 
-                current_pattern_progress = (current_pattern_progress + 1) % 2;
-            }
-        }
+    // a fast boot is racing to send a ring, the fade in would only hold up the sending pattern
+    enum CurrentPattern first_pattern = is_fast_boot() ? CurrentPattern_Off : CurrentPattern_StartingUp;
+
+    ESP_LOGI(TAG, "running %s, waiting for system ready pattern...", is_fast_boot() ? "nothing (fast boot)" : "led fade in");
 
-        if (xEventGroupGetBits(current_pattern_events) & CURRENT_PATTERN_UPDATED)
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++)
+    {
+        players[i].channel = i;
+        players[i].led = &led_channels[i];
+
+        start_pattern(&players[i], first_pattern, 0);
+    }
+
+    while (1)
+    {
+        TickType_t wait_ticks = portMAX_DELAY;
+
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++)
         {
-            xEventGroupClearBits(current_pattern_events, CURRENT_PATTERN_UPDATED);
+            TickType_t player_wait_ticks = pattern_wait_ticks(&players[i]);
+
+            wait_ticks = (player_wait_ticks < wait_ticks) ? player_wait_ticks : wait_ticks;
+        }
 
-            ESP_LOGI(TAG, "pattern update event triggered");
+        uint32_t notified = 0;
 
-            ESP_LOGI(TAG, "locking current_pattern_semaphore to get new pattern...");
+        xTaskNotifyWait(0, UINT32_MAX, &notified, wait_ticks);
 
-            if (xSemaphoreTake(current_pattern_semaphore, 0))
+        driver_wakeups++;
+
+        bool did_work = false;
+
+        // channels only share this loop, a fade ending on one never holds up another
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++)
+        {
+            struct LedPatternPlayer *player = &players[i];
+
+            bool player_updated = false;
+
+            // a pattern change pre-empts whatever is playing, including an error code that's half way through
+            if (notified & LED_NOTIFY_PATTERN_UPDATED(i))
             {
-                if (current_pattern_internal == current_pattern)
-                {
-                    xSemaphoreGive(current_pattern_semaphore);
-                }
-                else
+                trace(TraceEvent_PatternUpdate, i, 0);
+
+                enum CurrentPattern new_pattern;
+                int new_pattern_data;
+
+                get_current_pattern(i, &new_pattern, &new_pattern_data);
+
+                if (player->current != new_pattern || player->data != new_pattern_data)
                 {
-                    current_pattern_internal = current_pattern;
-                    current_pattern_data_internal = current_pattern_data;
-
-                    current_pattern_progress = -1;
-
-                    xSemaphoreGive(current_pattern_semaphore);
-
-                    ledc_fade_stop(led_channel.speed_mode, led_channel.channel);
-
-                    if (current_pattern_internal == CurrentPattern_Error)
-                    {
-                        if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
-                        {
-                            current_pattern_internal = CurrentPattern_Off;
-                            current_pattern = CurrentPattern_Off;
-
-                            xSemaphoreGive(current_pattern_semaphore);
-                        }
-
-                        ESP_LOGI(TAG, "pattern set to CurrentPattern_Error, running blocking effect...");
-
-                        // yes this should block, we need the error code to fully play out to be useful
-
-                        ledc_set_duty(led_channel.speed_mode, led_channel.channel, 0);
-                        ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                        vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-
-                        ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MAX_DUTY);
-                        ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                        vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-
-                        ledc_set_duty(led_channel.speed_mode, led_channel.channel, 0);
-                        ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                        vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-
-                        ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MEDIUM_DUTY);
-                        ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                        vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-
-                        ledc_set_duty(led_channel.speed_mode, led_channel.channel, 0);
-                        ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                        vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-
-                        for (int i = ERROR_MAX_BITS - 1; i >= 0; i--)
-                        {
-                            if ((current_pattern_data_internal >> i) & 1)
-                            {
-                                ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MAX_DUTY);
-                                ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                                vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-                            }
-                            else
-                            {
-                                ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MEDIUM_DUTY);
-                                ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                                vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-                            }
-
-                            ledc_set_duty(led_channel.speed_mode, led_channel.channel, 0);
-                            ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                            vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-                        }
-
-                        ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MEDIUM_DUTY);
-                        ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-                        vTaskDelay(ERROR_HOLD_TIME / portTICK_PERIOD_MS);
-
-                        ledc_set_fade_with_time(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            0,
-                            ERROR_HOLD_TIME
-                        );
-                        ledc_fade_start(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LEDC_FADE_NO_WAIT
-                        );
-
-                        xSemaphoreTake(fade_complete_semaphore, portMAX_DELAY);
-
-                        xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_COMPLETE);
-
-                        ESP_LOGI(TAG, "blocking effect done, sent pattern complete event");
-                    }
-                    else if (current_pattern_internal == CurrentPattern_WifiDisconnected)
-                    {
-                        ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MAX_DUTY);
-                        ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-
-                        vTaskDelay(LED_SAFE_PWM_CYCLE_DELAY / portTICK_PERIOD_MS);
-
-                        ledc_set_fade_with_time(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LED_MEDIUM_DUTY,
-                            WIFI_DISCONNECTED_SHORT_TIME
-                        );
-                        ledc_fade_start(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LEDC_FADE_NO_WAIT
-                        );
-
-                        current_pattern_progress = 1;
-                    }
-                    else if (current_pattern_internal == CurrentPattern_Updating)
-                    {
-                        current_pattern_progress = 0;
-
-                        ledc_set_duty(led_channel.speed_mode, led_channel.channel, LED_MAX_DUTY);
-                        ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-
-                        vTaskDelay(LED_SAFE_PWM_CYCLE_DELAY / portTICK_PERIOD_MS);
-
-                        ledc_set_fade_with_time(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            0,
-                            UPDATING_FADE_TIME
-                        );
-                        ledc_fade_start(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LEDC_FADE_NO_WAIT
-                        );
-                    }
-                    else if (current_pattern_internal == CurrentPattern_Ringing_Ringing)
-                    {
-                        ledc_set_fade_with_time(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LED_MAX_DUTY,
-                            RINGING_FADE_TIME
-                        );
-                        ledc_fade_start(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LEDC_FADE_NO_WAIT
-                        );
-                        current_pattern_progress = 0;
-                    }
-                    else if (current_pattern_internal == CurrentPattern_Ringing_Sending)
-                    {
-                        ledc_set_fade_with_time(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LED_MAX_DUTY,
-                            RINGING_FADE_TIME
-                        );
-                        ledc_fade_start(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LEDC_FADE_NO_WAIT
-                        );
-
-                        current_pattern_progress = 1;
-                    }
-                    else
-                    {
-                        ledc_set_fade_with_time(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            0,
-                            LED_TEST_FADE_TIME
-                        );
-                        ledc_fade_start(
-                            led_channel.speed_mode,
-                            led_channel.channel,
-                            LEDC_FADE_NO_WAIT
-                        );
-                    }
+                    start_pattern(player, new_pattern, new_pattern_data);
+
+                    player_updated = true;
                 }
             }
+
+            if (!player_updated)
+            {
+                player_updated = advance_pattern(player, notified & LED_NOTIFY_FADE_END(i));
+            }
+
+            did_work |= player_updated;
         }
 
-        vTaskDelay(5 / portTICK_PERIOD_MS);
+        if (!did_work)
+        {
+            driver_idle_wakeups++;
+        }
     }
 }
@@ -1,8 +1,13 @@
 #ifndef PATTERN_DRIVER_THREAD_H
 #define PATTERN_DRIVER_THREAD_H
 
+#include <stdint.h>
+#include <stdatomic.h>
+
 #include "freertos/idf_additions.h"
 
+#include "status.h"
+
 enum CurrentPattern {
     CurrentPattern_StartingUp = -1,
     CurrentPattern_Off = 0,
@@ -13,14 +18,28 @@ enum CurrentPattern {
     CurrentPattern_Ringing_Sending = 5,
 };
 
-extern enum CurrentPattern current_pattern;
-extern int current_pattern_data;
+// per led channel, pattern in the low byte and its data above, so the sync thread hands a pattern over with a single store
+extern atomic_uint_least32_t current_pattern_states[LED_CHANNEL_COUNT];
 
-extern SemaphoreHandle_t current_pattern_semaphore;
 extern EventGroupHandle_t current_pattern_events;
-#define CURRENT_PATTERN_UPDATED     BIT0
 #define CURRENT_PATTERN_COMPLETE    BIT1
 
+// data of the last pattern that sent CURRENT_PATTERN_COMPLETE, on any channel
+extern atomic_int completed_pattern_data;
+
+// esp_timer microseconds of the last pattern each channel started, and of it finishing or wrapping around to its loop point
+extern volatile int64_t pattern_start_times[LED_CHANNEL_COUNT];
+extern volatile int64_t pattern_pass_times[LED_CHANNEL_COUNT];
+
+// everything the driver thread wakes up for arrives as a bit in its task notification, one of each per channel
+extern TaskHandle_t led_pattern_driver_thread_handle;
+#define LED_NOTIFY_FADE_END(channel)        (1 << (channel))
+#define LED_NOTIFY_PATTERN_UPDATED(channel) (1 << (16 + (channel)))
+
+// publishes the pattern for one led channel and wakes the driver thread
+void set_current_pattern(int channel, enum CurrentPattern pattern, int data);
+void get_current_pattern(int channel, enum CurrentPattern *pattern, int *data);
+
 void led_pattern_driver_thread_entrypoint(void * arg);
 
 #endif
@@ -4,6 +4,7 @@
 #include "pattern_driver_thread.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <inttypes.h>
@@ -16,24 +17,29 @@
 
 static const char *TAG = "status";
 
-static TaskHandle_t led_pattern_driver_thread_handle;
 static TaskHandle_t led_status_sync_thread_handle;
 
 ledc_timer_config_t led_timer;
-ledc_channel_config_t led_channel;
+ledc_channel_config_t led_channels[LED_CHANNEL_COUNT];
 ledc_cbs_t led_callbacks;
 
-SemaphoreHandle_t fade_complete_semaphore;
+struct LedChannelPins {
+    int gpio_num;
+    ledc_channel_t channel;
+};
 
+static const struct LedChannelPins led_channel_pins[LED_CHANNEL_COUNT] = LED_CHANNEL_PINS;
+
+// one dispatcher for every channel, the channel index rides in user_arg and picks the notification bit
 bool IRAM_ATTR led_fade_end_interrupt(const ledc_cb_param_t *param, void *user_arg)
 {
     BaseType_t taskAwoken = pdFALSE;
 
-    if (param->event == LEDC_FADE_END_EVT)
+    if (param->event == LEDC_FADE_END_EVT && led_pattern_driver_thread_handle != NULL)
     {
-        SemaphoreHandle_t fade_complete_semaphore = (SemaphoreHandle_t) user_arg;
+        int channel_index = (int) (intptr_t) user_arg;
 
-        xSemaphoreGiveFromISR(fade_complete_semaphore, &taskAwoken);
+        xTaskNotifyFromISR(led_pattern_driver_thread_handle, LED_NOTIFY_FADE_END(channel_index), eSetBits, &taskAwoken);
     }
 
     return (taskAwoken == pdTRUE);
@@ -48,22 +54,27 @@ void start_status()
         .freq_hz = 2000,
         .speed_mode = LED_LS_MODE,
         .timer_num = LED_LS_TIMER,
-        .clk_cfg = LEDC_AUTO_CLK,
+        // rc fast keeps the pwm steady through dfs and running through light sleep (13 bits at 2 khz needs ~16.4 mhz of its ~17.5)
+        .clk_cfg = LEDC_USE_RC_FAST_CLK,
     };
     ESP_ERROR_CHECK(ledc_timer_config(&led_timer));
 
-    ESP_LOGI(TAG, "setting up led channel...");
+    ESP_LOGI(TAG, "setting up led channels...");
 
-    led_channel = (ledc_channel_config_t) {
-        .channel    = LED_LS_CH2_CHANNEL,
-        .duty       = 0,
-        .gpio_num   = LED_LS_CH2_GPIO,
-        .speed_mode = LED_LS_MODE,
-        .hpoint     = 0,
-        .timer_sel  = LED_LS_TIMER,
-        .flags.output_invert = 0
-    };
-    ESP_ERROR_CHECK(ledc_channel_config(&led_channel));
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++)
+    {
+        led_channels[i] = (ledc_channel_config_t) {
+            .channel    = led_channel_pins[i].channel,
+            .duty       = 0,
+            .gpio_num   = led_channel_pins[i].gpio_num,
+            .speed_mode = LED_LS_MODE,
+            .hpoint     = 0,
+            .timer_sel  = LED_LS_TIMER,
+            .sleep_mode = LEDC_SLEEP_MODE_KEEP_ALIVE,
+            .flags.output_invert = 0
+        };
+        ESP_ERROR_CHECK(ledc_channel_config(&led_channels[i]));
+    }
 
     ESP_LOGI(TAG, "starting led fade function...");
 
@@ -71,21 +82,14 @@ void start_status()
 
     ESP_LOGI(TAG, "initializing state...");
 
-    fade_complete_semaphore = xSemaphoreCreateCounting(1, 0);
-
-    current_pattern = CurrentPattern_StartingUp;
-    current_pattern_data = 0;
-
-    current_pattern_semaphore = xSemaphoreCreateMutex();
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++)
+    {
+        atomic_store(&current_pattern_states[i], (uint8_t) CurrentPattern_StartingUp);
+    }
     current_pattern_events = xEventGroupCreate();
 
-    system_ready = false;
-    indicating_error = 0;
-    indicating_wifi_status = WifiStatus_Connecting;
-    indicating_updating = false;
-    indicating_ringing = RingingStatus_Off;
-
-    status_state_semaphore = xSemaphoreCreateMutex();
+    // not ready, no error, wifi connecting, not updating, not ringing
+    atomic_store(&status_state, 0);
     status_state_events = xEventGroupCreate();
 
     ESP_LOGI(TAG, "registering callbacks...");
@@ -93,7 +97,10 @@ void start_status()
     led_callbacks = (ledc_cbs_t) {
         .fade_cb = led_fade_end_interrupt
     };
-    ESP_ERROR_CHECK(ledc_cb_register(led_channel.speed_mode, led_channel.channel, &led_callbacks, (void *) fade_complete_semaphore));
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++)
+    {
+        ESP_ERROR_CHECK(ledc_cb_register(led_channels[i].speed_mode, led_channels[i].channel, &led_callbacks, (void *) (intptr_t) i));
+    }
 
     ESP_LOGI(TAG, "starting threads...");
 
@@ -117,92 +124,52 @@ void start_status()
     ESP_LOGI(TAG, "initialization finished");
 }
 
-void ready_status()
+// setters are called from the socket event handler and the doorbell thread, they never block
+static void publish_status(uint32_t shift, uint32_t mask, uint32_t value)
 {
-    ESP_LOGI(TAG, "acquiring status_state_semaphore lock to set system ready...");
+    uint32_t state = atomic_load(&status_state);
+    uint32_t updated;
 
-    if (xSemaphoreTake(status_state_semaphore, portMAX_DELAY))
+    do
     {
-        system_ready = true;
-
-        xSemaphoreGive(status_state_semaphore);
-        xEventGroupSetBits(status_state_events, STATUS_STATE_UPDATED);
-
-        ESP_LOGI(TAG, "set system ready");
+        updated = (state & ~(mask << shift)) | ((value & mask) << shift);
     }
+    while (!atomic_compare_exchange_weak(&status_state, &state, updated));
+
+    xEventGroupSetBits(status_state_events, STATUS_STATE_UPDATED);
 }
 
-void update_ringing_status(enum RingingStatus ringing)
+void ready_status()
 {
-    ESP_LOGI(TAG, "acquiring status_state_semaphore lock to set ringing state...");
+    publish_status(STATUS_WORD_READY_SHIFT, STATUS_WORD_READY_MASK, true);
 
-    if (xSemaphoreTake(status_state_semaphore, portMAX_DELAY))
-    {
-        indicating_ringing = ringing;
+    ESP_LOGI(TAG, "set system ready");
+}
 
-        xSemaphoreGive(status_state_semaphore);
-        xEventGroupSetBits(status_state_events, STATUS_STATE_UPDATED);
+void update_ringing_status(enum RingingStatus ringing)
+{
+    publish_status(STATUS_WORD_RINGING_SHIFT, STATUS_WORD_RINGING_MASK, ringing);
 
-        ESP_LOGI(TAG, "set ringing state");
-    }
+    ESP_LOGD(TAG, "set ringing state");
 }
 
 void update_updating_status(bool updating)
 {
-    ESP_LOGI(TAG, "acquiring status_state_semaphore lock to set updating state...");
-
-    if (xSemaphoreTake(status_state_semaphore, portMAX_DELAY))
-    {
-        indicating_updating = updating;
+    publish_status(STATUS_WORD_UPDATING_SHIFT, STATUS_WORD_UPDATING_MASK, updating);
 
-        xSemaphoreGive(status_state_semaphore);
-        xEventGroupSetBits(status_state_events, STATUS_STATE_UPDATED);
-
-        ESP_LOGI(TAG, "set updating state");
-    }
+    ESP_LOGD(TAG, "set updating state");
 }
 
 void update_wifi_status(enum WifiStatus wifi_status)
 {
-    ESP_LOGI(TAG, "acquiring status_state_semaphore lock to set wifi state...");
+    publish_status(STATUS_WORD_WIFI_SHIFT, STATUS_WORD_WIFI_MASK, wifi_status);
 
-    if (xSemaphoreTake(status_state_semaphore, portMAX_DELAY))
-    {
-        indicating_wifi_status = wifi_status;
-
-        xSemaphoreGive(status_state_semaphore);
-        xEventGroupSetBits(status_state_events, STATUS_STATE_UPDATED);
-
-        ESP_LOGI(TAG, "set wifi state");
-    }
+    ESP_LOGD(TAG, "set wifi state");
 }
 
 void display_error(int error)
 {
-    ESP_LOGI(TAG, "acquiring status_state_semaphore lock to set display error...");
-
-    if (xSemaphoreTake(status_state_semaphore, portMAX_DELAY))
-    {
-        indicating_error = error;
+    publish_status(STATUS_WORD_ERROR_SHIFT, STATUS_WORD_ERROR_MASK, error);
 
-        xSemaphoreGive(status_state_semaphore);
-        xEventGroupSetBits(status_state_events, STATUS_STATE_UPDATED);
-
-        ESP_LOGI(TAG, "set display error");
-    }
-}
-
-void prepare_status_for_sleep()
-{
-    ledc_set_duty(led_channel.speed_mode, led_channel.channel, 0);
-    ledc_update_duty(led_channel.speed_mode, led_channel.channel);
-
-    vTaskDelay(LED_SAFE_PWM_CYCLE_DELAY / portTICK_PERIOD_MS);
-
-    gpio_hold_en(LED_LS_CH2_GPIO);
-}
-
-void wake_status_from_sleep()
-{
-    gpio_hold_dis(LED_LS_CH2_GPIO);
+    ESP_LOGD(TAG, "set display error");
 }
@@ -12,9 +12,24 @@
 #define LED_LS_CH2_GPIO       2
 #define LED_LS_CH2_CHANNEL    LEDC_CHANNEL_2
 
+// every status led runs off LED_LS_TIMER with its own pattern, an rgb led is three of them.
+// add the gpio and ledc channel of another led to LED_CHANNEL_PINS and bump the count
+#define LED_CHANNEL_COUNT     1
+#define LED_CHANNEL_PINS      { { LED_LS_CH2_GPIO, LED_LS_CH2_CHANNEL } }
+
+// which led each group of statuses shows on, point LED_RING_CHANNEL at a second led to show rings next to wifi state
+#define LED_STATUS_CHANNEL    0
+#define LED_RING_CHANNEL      LED_STATUS_CHANNEL
+
 #define LED_MAX_DUTY          8191
-#define LED_MEDIUM_DUTY       2047
-#define LED_INDICATE_DUTY     256
+
+// perceived brightness (cie lightness in tenths of a percent), see led_brightness_to_duty
+#define LED_MAX_BRIGHTNESS      1000
+#define LED_MEDIUM_BRIGHTNESS   571
+#define LED_INDICATE_BRIGHTNESS 205
+
+// hardware fades a fade across the whole brightness range is split into, shorter fades get fewer
+#define LED_FADE_SEGMENTS     8
 
 #define LED_SAFE_PWM_CYCLE_DELAY 1
 
@@ -31,6 +46,14 @@
 
 #define RINGING_FADE_TIME    500
 
+// wifi has to stay down this long before the led shows it, and then shows it at least this long
+#define WIFI_STATUS_ACTIVATE_TIME    2000
+#define WIFI_STATUS_MIN_DISPLAY_TIME 3000
+
+// stale ringing states stop showing if the message that ends them never arrives
+#define RINGING_STATUS_TTL    60000
+#define SENDING_STATUS_TTL    30000
+
 enum RingingStatus {
     RingingStatus_Off = 0,
     RingingStatus_Sending = 1,
@@ -43,11 +66,9 @@ enum WifiStatus {
 };
 
 extern ledc_timer_config_t led_timer;
-extern ledc_channel_config_t led_channel;
+extern ledc_channel_config_t led_channels[LED_CHANNEL_COUNT];
 extern ledc_cbs_t led_callbacks;
 
-extern SemaphoreHandle_t fade_complete_semaphore;
-
 void start_status();
 
 void ready_status();
@@ -57,7 +78,4 @@ void update_updating_status(bool updating);
 void update_wifi_status(enum WifiStatus wifi_status);
 void display_error(int error);
 
-void prepare_status_for_sleep();
-void wake_status_from_sleep();
-
 #endif
@@ -0,0 +1,126 @@
+#include "status_arbiter.h"
+
+#include "trace/trace.h"
+
+#include <inttypes.h>
+
+#include "esp_log.h"
+
+static const char *TAG = "status (arbiter)";
+
+static void count_switch(struct StatusArbiter *arbiter, int64_t now)
+{
+    if (now - arbiter->hour_start >= STATUS_ARBITER_HOUR)
+    {
+        // a gap of more than an hour without switches means the last hour had none either
+        arbiter->switches_last_hour = (now - arbiter->hour_start < 2 * STATUS_ARBITER_HOUR) ? arbiter->switches_this_hour : 0;
+        arbiter->switches_this_hour = 0;
+        arbiter->hour_start = now;
+    }
+
+    arbiter->switches++;
+    arbiter->switches_this_hour++;
+}
+
+int64_t arbitrate_status(struct StatusArbiter *arbiter, const struct StatusState *state, int64_t now)
+{
+    int64_t next_change = INT64_MAX;
+
+    struct StatusSource *candidate = NULL;
+    enum CurrentPattern candidate_pattern = CurrentPattern_Off;
+    int candidate_data = 0;
+
+    for (int i = 0; i < arbiter->source_count; i++)
+    {
+        struct StatusSource *source = &arbiter->sources[i];
+
+        if (source->channel != arbiter->channel)
+        {
+            continue;
+        }
+
+        enum CurrentPattern pattern;
+        int data;
+
+        if (!source->get_pattern(state, &pattern, &data))
+        {
+            source->active_since = 0;
+            continue;
+        }
+
+        if (source->active_since == 0)
+        {
+            source->active_since = now;
+        }
+
+        int64_t active_until = source->active_since + source->activate_time;
+        int64_t expires = source->active_since + source->ttl;
+
+        if (now < active_until)
+        {
+            next_change = (active_until < next_change) ? active_until : next_change;
+            continue;
+        }
+
+        if (source->ttl != 0)
+        {
+            if (now >= expires)
+            {
+                continue;
+            }
+
+            next_change = (expires < next_change) ? expires : next_change;
+        }
+
+        if (candidate == NULL || source->priority > candidate->priority)
+        {
+            candidate = source;
+            candidate_pattern = pattern;
+            candidate_data = data;
+        }
+    }
+
+    // only something more important cuts the minimum display time short
+    if (arbiter->shown != NULL && (candidate == NULL || candidate->priority <= arbiter->shown->priority))
+    {
+        int64_t shown_until = arbiter->shown_since + arbiter->shown->min_display_time;
+
+        if (now < shown_until)
+        {
+            return ((shown_until < next_change) ? shown_until : next_change) - now;
+        }
+    }
+
+    if (candidate == NULL)
+    {
+        return (next_change == INT64_MAX) ? -1 : next_change - now;
+    }
+
+    bool pattern_changed = arbiter->shown == NULL || candidate_pattern != arbiter->shown_pattern || candidate_data != arbiter->shown_data;
+
+    if (candidate != arbiter->shown)
+    {
+        arbiter->shown = candidate;
+        arbiter->shown_since = now;
+    }
+
+    // a source taking over the pattern that's already up doesn't touch the led
+    if (pattern_changed)
+    {
+        count_switch(arbiter, now);
+
+        trace(TraceEvent_StatusShown, arbiter->channel, candidate->priority);
+
+        ESP_LOGD(
+            TAG, "led %d showing %s (priority %d), %" PRIu32 " switches this hour, %" PRIu32 " last hour, %" PRIu32 " total",
+            arbiter->channel, candidate->name, candidate->priority, arbiter->switches_this_hour, arbiter->switches_last_hour, arbiter->switches
+        );
+
+        arbiter->shown_pattern = candidate_pattern;
+        arbiter->shown_data = candidate_data;
+
+        set_current_pattern(arbiter->channel, candidate_pattern, candidate_data);
+    }
+
+    return (next_change == INT64_MAX) ? -1 : next_change - now;
+}
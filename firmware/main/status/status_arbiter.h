@@ -0,0 +1,52 @@
+#ifndef STATUS_ARBITER_H
+#define STATUS_ARBITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "status_sync_thread.h"
+#include "pattern_driver_thread.h"
+
+#define STATUS_ARBITER_HOUR (60 * 60 * 1000)
+
+// one thing the led can show. the highest priority source that's eligible gets the led
+struct StatusSource {
+    const char *name;
+    // led channel it shows on, sources on different channels show at the same time
+    int channel;
+    int priority;
+    // ms a source has to stay active before it's shown, bounces shorter than this never reach the led
+    uint32_t activate_time;
+    // ms it stays shown before anything but a higher priority source replaces it
+    uint32_t min_display_time;
+    // ms after activating that the source is ignored until it goes inactive again, 0 for never
+    uint32_t ttl;
+    // whether the source is active in the snapshot, and the pattern it wants
+    bool (*get_pattern)(const struct StatusState *state, enum CurrentPattern *pattern, int *data);
+
+    // esp_timer ms the source became active, 0 while it isn't
+    int64_t active_since;
+};
+
+// one per led channel
+struct StatusArbiter {
+    int channel;
+    struct StatusSource *sources;
+    int source_count;
+
+    struct StatusSource *shown;
+    enum CurrentPattern shown_pattern;
+    int shown_data;
+    int64_t shown_since;
+
+    uint32_t switches;
+    uint32_t switches_this_hour;
+    uint32_t switches_last_hour;
+    int64_t hour_start;
+};
+
+// picks what the led should show and sets it if it changed.
+// returns ms until the choice can change without a new snapshot, or -1 if only a snapshot can change it
+int64_t arbitrate_status(struct StatusArbiter *arbiter, const struct StatusState *state, int64_t now);
+
+#endif
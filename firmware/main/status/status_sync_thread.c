@@ -1,7 +1,9 @@
 #include "status_sync_thread.h"
 
 #include "pattern_driver_thread.h"
+#include "status_arbiter.h"
 #include "status.h"
+#include "trace/trace.h"
 
 #include <unistd.h>
 #include <pthread.h>
@@ -10,192 +12,158 @@
 #include "freertos/idf_additions.h"
 #include "freertos/task.h"
 
+#include "esp_timer.h"
 #include "esp_log.h"
 
 static const char *TAG = "status (led status sync thread)";
 
-bool system_ready;
+atomic_uint_least32_t status_state;
 
-int indicating_error;
-enum WifiStatus indicating_wifi_status;
-bool indicating_updating;
-enum RingingStatus indicating_ringing;
-
-SemaphoreHandle_t status_state_semaphore;
 EventGroupHandle_t status_state_events;
 
-void led_status_sync_thread_entrypoint(void * arg)
+struct StatusState read_status_state()
 {
-    // priority:
-    // display error
-    // wifi connection
-    // update
-    // ringing status
+    uint32_t state = atomic_load(&status_state);
+
+    return (struct StatusState) {
+        .system_ready = STATUS_WORD_GET(state, READY),
+        .error = STATUS_WORD_GET(state, ERROR),
+        .wifi_status = STATUS_WORD_GET(state, WIFI),
+        .updating = STATUS_WORD_GET(state, UPDATING),
+        .ringing = STATUS_WORD_GET(state, RINGING),
+    };
+}
 
-    ESP_LOGI(TAG, "waiting for system ready...");
+// only clears the error if no other one replaced it in the meantime
+static void clear_status_error(int error)
+{
+    uint32_t state = atomic_load(&status_state);
 
-    while (1)
+    while (STATUS_WORD_GET(state, ERROR) == (uint32_t) error)
     {
-        if (xSemaphoreTake(status_state_semaphore, portMAX_DELAY))
-        {
-            if (!system_ready)
-            {
-                xSemaphoreGive(status_state_semaphore);
-                xEventGroupWaitBits(status_state_events, STATUS_STATE_UPDATED, pdTRUE, pdFALSE, portMAX_DELAY);
-            }
-            else
-            {
-                xSemaphoreGive(status_state_semaphore);
-                break;
-            }
-        }
-        else
+        uint32_t cleared = state & ~(STATUS_WORD_ERROR_MASK << STATUS_WORD_ERROR_SHIFT);
+
+        if (atomic_compare_exchange_weak(&status_state, &state, cleared))
         {
-            vTaskDelay(2 / portTICK_PERIOD_MS);
+            break;
         }
     }
+}
 
-    ESP_LOGI(TAG, "acquiring current_pattern_semaphore lock to display pattern 0...");
+static bool ring_confirmation_pattern(const struct StatusState *state, enum CurrentPattern *pattern, int *data)
+{
+    *pattern = CurrentPattern_Ringing_Ringing;
+    *data = 1;
 
-    if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
-    {
-        current_pattern = 0;
+    return state->ringing == RingingStatus_Ringing;
+}
 
-        xSemaphoreGive(current_pattern_semaphore);
-        xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_UPDATED);
+static bool error_pattern(const struct StatusState *state, enum CurrentPattern *pattern, int *data)
+{
+    *pattern = CurrentPattern_Error;
+    *data = state->error;
 
-        ESP_LOGI(TAG, "displayed pattern 0");
-    }
+    return state->error != 0;
+}
 
-    while (1)
-    {
-        ESP_LOGI(TAG, "acquiring status_state_semaphore lock to read indicating statuses...");
+static bool wifi_pattern(const struct StatusState *state, enum CurrentPattern *pattern, int *data)
+{
+    *pattern = CurrentPattern_WifiDisconnected;
+    *data = 0;
 
-        if (xSemaphoreTake(status_state_semaphore, portMAX_DELAY))
-        {
-            int new_indicating_error = indicating_error;
-            enum WifiStatus new_indicating_wifi_status = indicating_wifi_status;
-            bool new_indicating_updating = indicating_updating;
-            enum RingingStatus new_indicating_ringing = indicating_ringing;
+    return state->wifi_status != WifiStatus_Connected;
+}
 
-            xSemaphoreGive(status_state_semaphore);
+static bool updating_pattern(const struct StatusState *state, enum CurrentPattern *pattern, int *data)
+{
+    *pattern = CurrentPattern_Updating;
+    *data = 0;
 
-            ESP_LOGI(TAG, "finished reading indicating statuses");
+    return state->updating;
+}
 
-            if (new_indicating_error != 0)
-            {
-                ESP_LOGI(TAG, "indicating error present, locking current_pattern_semaphore to set pattern to CurrentPattern_Error...");
+static bool ring_sending_pattern(const struct StatusState *state, enum CurrentPattern *pattern, int *data)
+{
+    *pattern = CurrentPattern_Ringing_Sending;
+    *data = 0;
 
-                xEventGroupClearBits(current_pattern_events, CURRENT_PATTERN_COMPLETE);
+    return state->ringing == RingingStatus_Sending;
+}
 
-                if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
-                {
-                    current_pattern = CurrentPattern_Error;
-                    current_pattern_data = new_indicating_error;
+static bool off_pattern(const struct StatusState *state, enum CurrentPattern *pattern, int *data)
+{
+    *pattern = CurrentPattern_Off;
+    *data = 0;
 
-                    xSemaphoreGive(current_pattern_semaphore);
-                    xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_UPDATED);
+    return true;
+}
 
-                    ESP_LOGI(TAG, "set pattern to CurrentPattern_Error and sent update");
-                }
+// an error code cut off by a higher priority source plays again from the start once it's shown again,
+// it stays active until the driver reports that it played out
+static struct StatusSource status_sources[] = {
+    { "ring confirmation", LED_RING_CHANNEL, 5, 0, 0, RINGING_STATUS_TTL, ring_confirmation_pattern },
+    { "error", LED_STATUS_CHANNEL, 4, 0, 0, 0, error_pattern },
+    { "wifi disconnected", LED_STATUS_CHANNEL, 3, WIFI_STATUS_ACTIVATE_TIME, WIFI_STATUS_MIN_DISPLAY_TIME, 0, wifi_pattern },
+    { "updating", LED_STATUS_CHANNEL, 2, 0, 0, 0, updating_pattern },
+    { "ring sending", LED_RING_CHANNEL, 1, 0, 0, SENDING_STATUS_TTL, ring_sending_pattern },
+    // every channel needs something to fall back to
+    { "off", LED_STATUS_CHANNEL, 0, 0, 0, 0, off_pattern },
+    { "ring off", LED_RING_CHANNEL, 0, 0, 0, 0, off_pattern },
+};
 
-                ESP_LOGI(TAG, "acquiring status_state_semaphore lock to update indicating error...");
+void led_status_sync_thread_entrypoint(void * arg)
+{
+    struct StatusArbiter arbiters[LED_CHANNEL_COUNT];
 
-                if (xSemaphoreTake(status_state_semaphore, portMAX_DELAY))
-                {
-                    indicating_error = 0;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++)
+    {
+        arbiters[i] = (struct StatusArbiter) {
+            .channel = i,
+            .sources = status_sources,
+            .source_count = sizeof(status_sources) / sizeof(status_sources[0]),
+            .hour_start = esp_timer_get_time() / 1000,
+        };
+    }
 
-                    xSemaphoreGive(status_state_semaphore);
+    ESP_LOGI(TAG, "waiting for system ready...");
 
-                    ESP_LOGI(TAG, "indicating error updated");
-                }
+    while (!read_status_state().system_ready)
+    {
+        xEventGroupWaitBits(status_state_events, STATUS_STATE_UPDATED, pdTRUE, pdFALSE, portMAX_DELAY);
+    }
 
-                ESP_LOGI(TAG, "waiting for pattern complete event...");
+    while (1)
+    {
+        if (xEventGroupGetBits(current_pattern_events) & CURRENT_PATTERN_COMPLETE)
+        {
+            xEventGroupClearBits(current_pattern_events, CURRENT_PATTERN_COMPLETE);
 
-                xEventGroupWaitBits(current_pattern_events, CURRENT_PATTERN_COMPLETE, pdTRUE, pdFALSE, portMAX_DELAY);
-            }
-            else if (new_indicating_wifi_status != WifiStatus_Connected)
-            {
-                ESP_LOGI(TAG, "indicating wifi status set, locking current_pattern_semaphore to set pattern to CurrentPattern_WifiDisconnected...");
+            int completed_error = atomic_load(&completed_pattern_data);
 
-                if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
-                {
-                    current_pattern = CurrentPattern_WifiDisconnected;
-                    current_pattern_data = 0;
+            trace(TraceEvent_ErrorFinished, completed_error, 0);
 
-                    xSemaphoreGive(current_pattern_semaphore);
-                    xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_UPDATED);
+            // a different error raised while this one played is still waiting its turn
+            clear_status_error(completed_error);
+        }
 
-                    ESP_LOGI(TAG, "set pattern to CurrentPattern_WifiDisconnected and sent update");
-                }
-            }
-            else if (new_indicating_updating)
-            {
-                ESP_LOGI(TAG, "indicating updating set, locking current_pattern_semaphore to set pattern to CurrentPattern_Updating...");
+        struct StatusState state = read_status_state();
 
-                if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
-                {
-                    current_pattern = CurrentPattern_Updating;
-                    current_pattern_data = 0;
+        int64_t now = esp_timer_get_time() / 1000;
+        int64_t next_change = -1;
 
-                    xSemaphoreGive(current_pattern_semaphore);
-                    xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_UPDATED);
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++)
+        {
+            int64_t channel_next_change = arbitrate_status(&arbiters[i], &state, now);
 
-                    ESP_LOGI(TAG, "set pattern to CurrentPattern_Updating and sent update");
-                }
-            }
-            else if (new_indicating_ringing != RingingStatus_Off)
+            if (channel_next_change >= 0 && (next_change < 0 || channel_next_change < next_change))
             {
-                if (new_indicating_ringing == RingingStatus_Ringing)
-                {
-                    ESP_LOGI(TAG, "indicating ringing status set, locking current_pattern_semaphore to set pattern to CurrentPattern_Ringing_Ringing...");
-
-                    if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
-                    {
-                        current_pattern = CurrentPattern_Ringing_Ringing;
-                        current_pattern_data = 1;
-
-                        xSemaphoreGive(current_pattern_semaphore);
-                        xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_UPDATED);
-
-                        ESP_LOGI(TAG, "set pattern to CurrentPattern_Ringing_Ringing and sent update");
-                    }
-                }
-                else if (new_indicating_ringing == RingingStatus_Sending)
-                {
-                    ESP_LOGI(TAG, "indicating ringing status set, locking current_pattern_semaphore to set pattern to CurrentPattern_Ringing_Sending...");
-
-                    if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
-                    {
-                        current_pattern = CurrentPattern_Ringing_Sending;
-                        current_pattern_data = 0;
-
-                        xSemaphoreGive(current_pattern_semaphore);
-                        xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_UPDATED);
-
-                        ESP_LOGI(TAG, "set pattern to CurrentPattern_Ringing_Sending and sent update");
-                    }
-                }
-            }
-            else
-            {
-                ESP_LOGI(TAG, "no indicating status set, locking current_pattern_semaphore to set pattern to CurrentPattern_Off...");
-
-                if (xSemaphoreTake(current_pattern_semaphore, portMAX_DELAY))
-                {
-                    current_pattern = CurrentPattern_Off;
-                    current_pattern_data = 0;
-
-                    xSemaphoreGive(current_pattern_semaphore);
-                    xEventGroupSetBits(current_pattern_events, CURRENT_PATTERN_UPDATED);
-
-                    ESP_LOGI(TAG, "set pattern to CurrentPattern_Off and sent update");
-                }
+                next_change = channel_next_change;
             }
         }
 
-        ESP_LOGI(TAG, "waiting for STATUS_STATE_UPDATED...");
+        // sources waiting out their activate time, minimum display time or ttl need a wakeup without a status update
+        TickType_t wait_ticks = (next_change < 0) ? portMAX_DELAY : pdMS_TO_TICKS(next_change) + 1;
 
-        xEventGroupWaitBits(status_state_events, STATUS_STATE_UPDATED, pdTRUE, pdFALSE, portMAX_DELAY);
+        xEventGroupWaitBits(status_state_events, STATUS_STATE_UPDATED, pdTRUE, pdFALSE, wait_ticks);
     }
 }
@@ -2,20 +2,41 @@
 #define STATUS_SYNC_THREAD_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 #include "freertos/idf_additions.h"
 
-extern bool system_ready;
+#include "status.h"
 
-extern int indicating_error;
-extern enum WifiStatus indicating_wifi_status;
-extern bool indicating_updating;
-extern enum RingingStatus indicating_ringing;
+// every indicating status packed into one word, setters publish a change with a single atomic update and never block
+extern atomic_uint_least32_t status_state;
+#define STATUS_WORD_READY_SHIFT     0
+#define STATUS_WORD_READY_MASK      0x1
+#define STATUS_WORD_UPDATING_SHIFT  1
+#define STATUS_WORD_UPDATING_MASK   0x1
+#define STATUS_WORD_WIFI_SHIFT      2
+#define STATUS_WORD_WIFI_MASK       0x1
+#define STATUS_WORD_RINGING_SHIFT   4
+#define STATUS_WORD_RINGING_MASK    0x3
+#define STATUS_WORD_ERROR_SHIFT     8
+#define STATUS_WORD_ERROR_MASK      0xff
+
+#define STATUS_WORD_GET(state, field) (((state) >> STATUS_WORD_##field##_SHIFT) & STATUS_WORD_##field##_MASK)
 
-extern SemaphoreHandle_t status_state_semaphore;
 extern EventGroupHandle_t status_state_events;
 #define STATUS_STATE_UPDATED    BIT0
 
+struct StatusState {
+    bool system_ready;
+    int error;
+    enum WifiStatus wifi_status;
+    bool updating;
+    enum RingingStatus ringing;
+};
+
+struct StatusState read_status_state();
+
 void led_status_sync_thread_entrypoint(void * arg);
 
 #endif
@@ -0,0 +1,199 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "trace";
+
+// plain ram, so after a crash or a watchdog it's still there for the debugger
+static struct TraceRecord trace_records[TRACE_BUFFER_SIZE];
+
+static atomic_uint_least32_t trace_head;
+
+#ifdef TRACE_PRINT_LIVE
+static TaskHandle_t trace_flush_thread;
+
+// set while the flush thread is blocked with nothing to print, the next record wakes it so an idle ring never does
+static atomic_bool trace_flush_waiting;
+#endif
+
+// every format takes both args as unsigned long, unused ones are ignored
+static const char *event_formats[TraceEvent_Count] = {
+    [TraceEvent_None] = "none",
+    [TraceEvent_Press] = "press #%lu (type %lu)",
+    [TraceEvent_PressesCoalesced] = "coalesced presses #%lu to #%lu",
+    [TraceEvent_RingStart] = "ring (wait for connection: %lu)",
+    [TraceEvent_RingSend] = "sending ring",
+    [TraceEvent_RingSent] = "ring sent",
+    [TraceEvent_RingFailed] = "ring failed, error %lu",
+    [TraceEvent_RingConfirmed] = "server says ringing: %lu",
+    [TraceEvent_SocketConnected] = "socket connected",
+    [TraceEvent_SocketDisconnected] = "socket disconnected, buffer allocations: %lu, failed: %lu",
+    [TraceEvent_SocketError] = "socket error",
+    [TraceEvent_SocketMessage] = "socket message, opcode %lu, %lu bytes",
+    [TraceEvent_PatternUpdate] = "led %lu pattern update",
+    [TraceEvent_PatternStart] = "led %lu starting pattern 0x%04lx (data << 8 | pattern)",
+    [TraceEvent_PatternFinished] = "led %lu finished pattern %lu",
+    [TraceEvent_DriverWakeups] = "led driver woke %lu times since the last pattern, %lu with nothing to do",
+    [TraceEvent_StatusShown] = "led %lu showing source with priority %lu",
+    [TraceEvent_ErrorFinished] = "error %lu finished playing",
+};
+
+#ifdef TRACE_PRINT_LIVE
+static void IRAM_ATTR wake_trace_flush_thread()
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    if (xPortInIsrContext())
+    {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+
+        vTaskNotifyGiveFromISR(trace_flush_thread, &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
+
+        return;
+    }
+#endif
+
+    xTaskNotifyGive(trace_flush_thread);
+}
+#endif
+
+void IRAM_ATTR trace(enum TraceEvent event, uint32_t arg0, uint32_t arg1)
+{
+    uint32_t index = atomic_fetch_add_explicit(&trace_head, 1, memory_order_relaxed);
+
+    struct TraceRecord *record = &trace_records[index & (TRACE_BUFFER_SIZE - 1)];
+
+    atomic_store_explicit(&record->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    record->time = (uint32_t) esp_timer_get_time();
+    record->event = event;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+
+    atomic_store_explicit(&record->sequence, index + 1, memory_order_release);
+
+#ifdef TRACE_PRINT_LIVE
+    if (trace_flush_thread != NULL && atomic_exchange(&trace_flush_waiting, false))
+    {
+        wake_trace_flush_thread();
+    }
+#endif
+}
+
+// false if the slot has been overwritten or is still being written
+static bool read_trace_record(uint32_t index, struct TraceRecord *copy)
+{
+    struct TraceRecord *record = &trace_records[index & (TRACE_BUFFER_SIZE - 1)];
+
+    if (atomic_load_explicit(&record->sequence, memory_order_acquire) != index + 1)
+    {
+        return false;
+    }
+
+    copy->time = record->time;
+    copy->event = record->event;
+    copy->args[0] = record->args[0];
+    copy->args[1] = record->args[1];
+
+    atomic_thread_fence(memory_order_acquire);
+
+    return atomic_load_explicit(&record->sequence, memory_order_relaxed) == index + 1 && copy->event < TraceEvent_Count;
+}
+
+static void log_trace_record(uint32_t index, const struct TraceRecord *record, uint32_t now)
+{
+    char line[96];
+
+    snprintf(line, sizeof(line), event_formats[record->event], (unsigned long)record->args[0], (unsigned long)record->args[1]);
+
+    uint32_t age = now - record->time;
+
+    ESP_LOGI(TAG, "#%" PRIu32 " -%" PRIu32 ".%03" PRIu32 " ms: %s", index, age / 1000, age % 1000, line);
+}
+
+void trace_dump()
+{
+    uint32_t head = atomic_load(&trace_head);
+    uint32_t first = (head > TRACE_BUFFER_SIZE) ? head - TRACE_BUFFER_SIZE : 0;
+    uint32_t now = (uint32_t) esp_timer_get_time();
+
+    ESP_LOGI(TAG, "last %" PRIu32 " of %" PRIu32 " events:", head - first, head);
+
+    for (uint32_t i = first; i != head; i++)
+    {
+        struct TraceRecord record;
+
+        if (read_trace_record(i, &record))
+        {
+            log_trace_record(i, &record, now);
+        }
+    }
+}
+
+#ifdef TRACE_PRINT_LIVE
+static void trace_flush_thread_entrypoint(void *arg)
+{
+    uint32_t printed = 0;
+
+    while (1)
+    {
+        atomic_store(&trace_flush_waiting, true);
+
+        // checked after arming, a record traced before that didn't wake us
+        if (atomic_load(&trace_head) == printed)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        // let the rest of the burst come in, so a ring is printed in one go
+        vTaskDelay(TRACE_FLUSH_TIME / portTICK_PERIOD_MS);
+
+        uint32_t head = atomic_load(&trace_head);
+        uint32_t now = (uint32_t) esp_timer_get_time();
+
+        if (head - printed > TRACE_BUFFER_SIZE)
+        {
+            ESP_LOGI(TAG, "%" PRIu32 " events overwritten before they were printed", head - printed - TRACE_BUFFER_SIZE);
+
+            printed = head - TRACE_BUFFER_SIZE;
+        }
+
+        for (; printed != head; printed++)
+        {
+            struct TraceRecord record;
+
+            if (read_trace_record(printed, &record))
+            {
+                log_trace_record(printed, &record, now);
+            }
+        }
+    }
+}
+#endif
+
+void start_trace()
+{
+#ifdef TRACE_PRINT_LIVE
+    ESP_LOGI(TAG, "starting trace flush thread...");
+
+    // the formatting and uart time lands here, at most once a second, instead of on the thread that traced
+    xTaskCreate(
+        trace_flush_thread_entrypoint,
+        "trace flush thread",
+        4096,
+        NULL,
+        tskIDLE_PRIORITY,
+        &trace_flush_thread
+    );
+#endif
+}
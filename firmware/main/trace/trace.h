@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "log_control/log_control.h"
+
+// power of two, 20 bytes each
+#define TRACE_BUFFER_SIZE   256
+
+// debug builds print new records from a low priority task, release builds only keep them for trace_dump
+#ifdef LOG_HOT_PATHS
+#define TRACE_PRINT_LIVE
+#define TRACE_FLUSH_TIME    1000
+#endif
+
+enum TraceEvent {
+    TraceEvent_None = 0,
+    TraceEvent_Press = 1,
+    TraceEvent_PressesCoalesced = 2,
+    TraceEvent_RingStart = 3,
+    TraceEvent_RingSend = 4,
+    TraceEvent_RingSent = 5,
+    TraceEvent_RingFailed = 6,
+    TraceEvent_RingConfirmed = 7,
+    TraceEvent_SocketConnected = 8,
+    TraceEvent_SocketDisconnected = 9,
+    TraceEvent_SocketError = 10,
+    TraceEvent_SocketMessage = 11,
+    TraceEvent_PatternUpdate = 12,
+    TraceEvent_PatternStart = 13,
+    TraceEvent_PatternFinished = 14,
+    TraceEvent_DriverWakeups = 15,
+    TraceEvent_StatusShown = 16,
+    TraceEvent_ErrorFinished = 17,
+    TraceEvent_Count = 18,
+};
+
+struct TraceRecord {
+    // index + 1 once the record is complete, anything else while it's being (over)written
+    atomic_uint_least32_t sequence;
+    // low 32 bits of esp_timer microseconds, wraps every ~71 minutes
+    uint32_t time;
+    uint32_t event;
+    uint32_t args[2];
+};
+
+// safe from any task or isr, no formatting and no locks
+void trace(enum TraceEvent event, uint32_t arg0, uint32_t arg1);
+
+// formats every record still in the ring, oldest first
+void trace_dump();
+
+void start_trace();
+
+#endif
@@ -1,8 +1,13 @@
 #include "socket.h"
 
 #include "doorbell.h"
+#include "main.h"
 #include "status/status.h"
+#include "latency/latency.h"
+#include "log_control/log_control.h"
+#include "trace/trace.h"
 #include "websocket_client/esp_websocket_client.h"
+#include "tls_session.h"
 
 #include <stdbool.h>
 #include <string.h>
@@ -13,15 +18,52 @@
 #include "esp_tls.h"
 #include "esp_log.h"
 
+// the host build talks to a local stand-in for the api server
+#if CONFIG_IDF_TARGET_LINUX
+#define SOCKET_URI  "ws://127.0.0.1:8080/doorbell"
+#else
+#define SOCKET_URI  "wss://api.purduehackers.com/doorbell"
+#define SOCKET_PATH "/doorbell"
+// resume the previous tls session instead of a full handshake on every reconnect and wake
+#define SOCKET_USE_TLS_SESSION_CACHE
+#endif
+
+#define SOCKET_BUFFER_SIZE  1024
+#define SOCKET_USER_AGENT   "PurdueHackers/Doorbell"
+
+// the connection has to outlive light sleep, so tcp keepalive (seconds) keeps the ap and any nat in between from
+// timing it out, and finds a dead one before a ring does. websocket pings only have to keep the server happy,
+// every one of them is a radio wakeup
+#define SOCKET_KEEPALIVE_IDLE       60
+#define SOCKET_KEEPALIVE_INTERVAL   5
+#define SOCKET_KEEPALIVE_COUNT      3
+#define SOCKET_PING_INTERVAL        120
+
 static const char *TAG = "socket";
 
 EventGroupHandle_t websocket_events;
 
 static esp_tls_cfg_t tls_config;
 
+#ifdef SOCKET_USE_TLS_SESSION_CACHE
+static tls_keep_alive_cfg_t tls_keep_alive_config = {
+    .keep_alive_enable = true,
+    .keep_alive_idle = SOCKET_KEEPALIVE_IDLE,
+    .keep_alive_interval = SOCKET_KEEPALIVE_INTERVAL,
+    .keep_alive_count = SOCKET_KEEPALIVE_COUNT,
+};
+#endif
+
 static esp_websocket_client_config_t websocket_config;
+
+// reserved once so the client never touches the heap on the send/receive path
+static char socket_rx_buffer[SOCKET_BUFFER_SIZE];
+static char socket_tx_buffer[SOCKET_BUFFER_SIZE];
+
 static esp_websocket_client_handle_t websocket_client;
 
+static esp_transport_handle_t websocket_transport;
+
 static TimerHandle_t websocket_retry_timer;
 
 void socket_event_handler(
@@ -35,7 +77,7 @@ void socket_event_handler(
     {
         if (event_id == WEBSOCKET_EVENT_ERROR)
         {
-            ESP_LOGI(TAG, "socket error, queued restart...");
+            trace(TraceEvent_SocketError, 0, 0);
 
             stop_socket();
 
@@ -43,40 +85,52 @@ void socket_event_handler(
         }
         else if (event_id == WEBSOCKET_EVENT_CONNECTED)
         {
-            ESP_LOGI(TAG, "socket connected");
+            trace(TraceEvent_SocketConnected, 0, 0);
             xEventGroupSetBits(websocket_events, SOCKET_CONNECTED);
         }
         else if (event_id == WEBSOCKET_EVENT_DISCONNECTED || event_id == WEBSOCKET_EVENT_CLOSED)
         {
-            ESP_LOGI(TAG, "socket disconnected");
+            esp_websocket_client_mem_stats_t mem_stats = { 0 };
+            esp_websocket_client_get_mem_stats(websocket_client, &mem_stats);
+
+            trace(TraceEvent_SocketDisconnected, mem_stats.buffer_allocs, mem_stats.alloc_failures);
+
             xEventGroupClearBits(websocket_events, SOCKET_CONNECTED);
         }
         else if (event_id == WEBSOCKET_EVENT_DATA)
         {
-            ESP_LOGI(TAG, "socket message");
-
             esp_websocket_event_data_t message_event_data = *(esp_websocket_event_data_t*) event_data;
 
+            trace(TraceEvent_SocketMessage, message_event_data.op_code, message_event_data.payload_len);
+
             if (message_event_data.op_code == 1 && message_event_data.payload_len > 0)
             {
-                ESP_LOGI(TAG, "socket user message");
-
-                char first_character = *(message_event_data.data_ptr + message_event_data.payload_offset);
+                const char *message = message_event_data.data_ptr + message_event_data.payload_offset;
+                char first_character = *message;
 
                 if (first_character == 't')
                 {
-                    ESP_LOGI(TAG, "socket message: ring true");
+                    trace(TraceEvent_RingConfirmed, 1, 0);
 
                     xEventGroupClearBits(doorbell_events, DOORBELL_FINISHED_RINGING);
                     update_ringing_status(RingingStatus_Ringing);
                 }
                 else if (first_character == 'f')
                 {
-                    ESP_LOGI(TAG, "socket message: ring false");
+                    trace(TraceEvent_RingConfirmed, 0, 0);
 
                     update_ringing_status(RingingStatus_Off);
                     xEventGroupSetBits(doorbell_events, DOORBELL_FINISHED_RINGING);
                 }
+                else if (first_character == 'l' && message_event_data.data_len > 4 && strncmp(message, "log ", 4) == 0)
+                {
+                    // "log <tag> <level>"
+                    run_log_command(message + 4, message_event_data.data_len - 4);
+                }
+                else if (first_character == 's' && message_event_data.data_len == 5 && strncmp(message, "sleep", 5) == 0)
+                {
+                    dump_sleep_inhibits();
+                }
             }
         }
     }
@@ -105,6 +159,18 @@ void init_socket_state()
     );
 
     xTimerStop(websocket_retry_timer, 0);
+
+#ifdef SOCKET_USE_TLS_SESSION_CACHE
+    tls_config.keep_alive_cfg = &tls_keep_alive_config;
+
+    // created once and kept across socket restarts so the cached tls session is too
+    websocket_transport = init_tls_session_transport(&tls_config, SOCKET_PATH, SOCKET_USER_AGENT);
+
+    if (websocket_transport == NULL)
+    {
+        ESP_LOGI(TAG, "tls session transport failed! falling back to full handshakes...");
+    }
+#endif
 }
 
 void start_socket()
@@ -114,15 +180,29 @@ void start_socket()
     ESP_LOGI(TAG, "initializing socket config...");
 
     websocket_config = (esp_websocket_client_config_t) {
-        .uri = "wss://api.purduehackers.com/doorbell",
+        .uri = SOCKET_URI,
 
-        .user_agent = "PurdueHackers/Doorbell",
+        .user_agent = SOCKET_USER_AGENT,
+
+        .ext_transport = websocket_transport,
+        .ext_transport_get_socket = websocket_transport ? tls_session_get_socket : NULL,
+
+        .buffer_size = SOCKET_BUFFER_SIZE,
+        .rx_buffer = socket_rx_buffer,
+        .tx_buffer = socket_tx_buffer,
 
         .network_timeout_ms = 10000,
         .reconnect_timeout_ms = 1000,
+        // the tls session transport applies tls_keep_alive_config itself, these cover the client's own transports
+        .keep_alive_enable = true,
+        .keep_alive_idle = SOCKET_KEEPALIVE_IDLE,
+        .keep_alive_interval = SOCKET_KEEPALIVE_INTERVAL,
+        .keep_alive_count = SOCKET_KEEPALIVE_COUNT,
+        .ping_interval_sec = SOCKET_PING_INTERVAL,
         .disable_pingpong_discon = true,
         .disable_auto_reconnect = false,
-        .enable_close_reconnect = true
+        .enable_close_reconnect = true,
+        .event_driven_task = true
     };
 
     websocket_client = esp_websocket_client_init(&websocket_config);
@@ -214,19 +294,23 @@ enum RingError {
     RingError_SocketNotReady = 2,
     RingError_SocketNotConnected = 3,
     RingError_SendFailed = 4,
+    RingError_ConnectionTimeout = 5,
 };
 
 void ring_doorbell(bool wait_for_connection)
 {
+    latency_mark(LatencyStage_RingDoorbell);
+
+    trace(TraceEvent_RingStart, wait_for_connection, 0);
+
     if (wait_for_connection)
     {
-        ESP_LOGI(TAG, "waiting for connection...");
-
-        if (!(xEventGroupWaitBits(websocket_events, SOCKET_CONNECTED, pdFALSE, pdFALSE, portMAX_DELAY) & SOCKET_CONNECTED))
+        if (!(xEventGroupWaitBits(websocket_events, SOCKET_CONNECTED, pdFALSE, pdFALSE, RING_CONNECTION_TIMEOUT / portTICK_PERIOD_MS) & SOCKET_CONNECTED))
         {
-            ESP_LOGI(TAG, "connection wait failed!");
+            ESP_LOGI(TAG, "connection wait timed out!");
+            trace(TraceEvent_RingFailed, RingError_ConnectionTimeout, 0);
 
-            display_error(RingError_SocketNotReady);
+            display_error(RingError_ConnectionTimeout);
             update_ringing_status(RingingStatus_Off);
 
             vTaskDelay(5000 / portTICK_PERIOD_MS);
@@ -238,11 +322,10 @@ void ring_doorbell(bool wait_for_connection)
     }
     else
     {
-        ESP_LOGI(TAG, "checking connection...");
-
         if (websocket_client == NULL)
         {
             ESP_LOGI(TAG, "socket not initialized!");
+            trace(TraceEvent_RingFailed, RingError_NoSocket, 0);
 
             display_error(RingError_NoSocket);
             update_ringing_status(RingingStatus_Off);
@@ -259,6 +342,7 @@ void ring_doorbell(bool wait_for_connection)
         if (!(event_group_bits & SOCKET_READY))
         {
             ESP_LOGI(TAG, "socket not ready!");
+            trace(TraceEvent_RingFailed, RingError_SocketNotReady, 0);
 
             display_error(RingError_SocketNotReady);
             update_ringing_status(RingingStatus_Off);
@@ -272,6 +356,7 @@ void ring_doorbell(bool wait_for_connection)
         if (!(event_group_bits & SOCKET_CONNECTED))
         {
             ESP_LOGI(TAG, "socket not connected!");
+            trace(TraceEvent_RingFailed, RingError_SocketNotConnected, 0);
 
             display_error(RingError_SocketNotConnected);
             update_ringing_status(RingingStatus_Off);
@@ -284,11 +369,19 @@ void ring_doorbell(bool wait_for_connection)
         }
     }
 
-    ESP_LOGI(TAG, "sending message...");
+    latency_mark(LatencyStage_SocketConnected);
+
+    trace(TraceEvent_RingSend, 0, 0);
 
-    if (esp_websocket_client_send_text(websocket_client, "true", 4, 10000 / portTICK_PERIOD_MS) == -1)
+    latency_mark(LatencyStage_Send);
+
+    // on the stack and built fresh every ring: the websocket client masks it in place, and leaves it masked if the write fails
+    char ring_message[] = "true";
+
+    if (esp_websocket_client_send_text_inplace(websocket_client, ring_message, sizeof(ring_message) - 1, 10000 / portTICK_PERIOD_MS) == -1)
     {
         ESP_LOGI(TAG, "failed to send message!");
+        trace(TraceEvent_RingFailed, RingError_SendFailed, 0);
 
         display_error(RingError_SendFailed);
         update_ringing_status(RingingStatus_Off);
@@ -300,7 +393,9 @@ void ring_doorbell(bool wait_for_connection)
         return;
     }
 
-    ESP_LOGI(TAG, "ring send success!");
+    latency_mark(LatencyStage_Sent);
+
+    trace(TraceEvent_RingSent, 0, 0);
 
     // we don't need this i think (events will get it)
     // update_ringing_status(RingingStatus_Ringing);
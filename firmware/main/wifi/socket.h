@@ -11,6 +11,9 @@ extern EventGroupHandle_t websocket_events;
 #define SOCKET_CONNECTED    BIT1
 #define DOORBELL_RUNG       BIT2
 
+// long enough for a full wifi join with peap plus a tls handshake after waking up
+#define RING_CONNECTION_TIMEOUT 20000
+
 void init_socket_state();
 
 void start_socket();
@@ -0,0 +1,425 @@
+#include "tls_session.h"
+
+#include "main.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include "esp_transport_ws.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#if defined(SLEEP_USE_DEEP_SLEEP) && CONFIG_ESP_TLS_USING_MBEDTLS
+#include "mbedtls/ssl.h"
+
+// keep the session through deep sleep so the first connect after a wake is a resume
+#define TLS_SESSION_RETAIN_IN_RTC
+#endif
+
+#define TLS_SESSION_DEFAULT_PORT    443
+
+// serialized session, ticket and the server certificate's digest. the certificate itself isn't kept
+// (CONFIG_MBEDTLS_SSL_KEEP_PEER_CERTIFICATE is off, we never verify it), or it alone could outgrow this
+#define TLS_SESSION_RTC_SIZE        2048
+
+static const char *TAG = "tls_session";
+
+static esp_transport_handle_t tls_transport;
+static esp_transport_handle_t ws_transport;
+
+static esp_tls_cfg_t tls_session_config;
+static esp_tls_t *tls;
+
+// plain ram, which is retained through light sleep
+static esp_tls_client_session_t *cached_session;
+
+#ifdef TLS_SESSION_RETAIN_IN_RTC
+// deep sleep wipes the heap, rtc slow memory isn't
+static RTC_DATA_ATTR uint8_t rtc_session[TLS_SESSION_RTC_SIZE];
+static RTC_DATA_ATTR size_t rtc_session_length;
+#endif
+
+static uint32_t full_handshakes;
+static int64_t full_handshake_total_ms;
+static uint32_t resumed_handshakes;
+static int64_t resumed_handshake_total_ms;
+
+static void clear_tls_session()
+{
+    if (cached_session != NULL)
+    {
+        esp_tls_free_client_session(cached_session);
+        cached_session = NULL;
+    }
+}
+
+#ifdef TLS_SESSION_RETAIN_IN_RTC
+// esp_tls_client_session_t only wraps an mbedtls_ssl_session, which is its first member
+static void retain_tls_session()
+{
+    size_t length = 0;
+
+    if (mbedtls_ssl_session_save((const mbedtls_ssl_session *)cached_session, rtc_session, sizeof(rtc_session), &length) != 0)
+    {
+        ESP_LOGI(TAG, "session doesn't fit in rtc memory, the next deep sleep wake does a full handshake");
+        rtc_session_length = 0;
+        return;
+    }
+
+    rtc_session_length = length;
+}
+
+static void restore_tls_session()
+{
+    if (rtc_session_length == 0)
+    {
+        return;
+    }
+
+    mbedtls_ssl_session *session = calloc(1, sizeof(mbedtls_ssl_session));
+
+    if (session == NULL)
+    {
+        return;
+    }
+
+    mbedtls_ssl_session_init(session);
+
+    if (mbedtls_ssl_session_load(session, rtc_session, rtc_session_length) != 0)
+    {
+        ESP_LOGI(TAG, "rtc session didn't load, dropping it");
+
+        mbedtls_ssl_session_free(session);
+        free(session);
+        rtc_session_length = 0;
+
+        return;
+    }
+
+    ESP_LOGI(TAG, "restored tls session from rtc memory");
+
+    cached_session = (esp_tls_client_session_t *)session;
+}
+#endif
+
+static void save_tls_session()
+{
+    // only tls 1.2 is enabled, so the session id / ticket is known as soon as the handshake is done
+    esp_tls_client_session_t *session = esp_tls_get_client_session(tls);
+
+    if (session == NULL)
+    {
+        ESP_LOGI(TAG, "server didn't hand out a session, next connect does a full handshake");
+        return;
+    }
+
+    clear_tls_session();
+    cached_session = session;
+
+#ifdef TLS_SESSION_RETAIN_IN_RTC
+    retain_tls_session();
+#endif
+}
+
+static void capture_tls_error(esp_transport_handle_t t)
+{
+    esp_tls_error_handle_t tls_error;
+    esp_tls_error_handle_t transport_error = esp_transport_get_error_handle(t);
+
+    if (tls != NULL && transport_error != NULL && esp_tls_get_error_handle(tls, &tls_error) == ESP_OK)
+    {
+        *transport_error = *tls_error;
+    }
+}
+
+static void log_handshake_time(bool resumed, int64_t handshake_ms)
+{
+    if (resumed)
+    {
+        resumed_handshakes++;
+        resumed_handshake_total_ms += handshake_ms;
+    }
+    else
+    {
+        full_handshakes++;
+        full_handshake_total_ms += handshake_ms;
+    }
+
+    ESP_LOGI(TAG, "tls handshake took %" PRId64 " ms (%s)", handshake_ms, resumed ? "cached session" : "full");
+    ESP_LOGI(TAG, "average handshake: full %" PRId64 " ms over %lu, cached session %" PRId64 " ms over %lu",
+        full_handshakes ? full_handshake_total_ms / full_handshakes : 0, (unsigned long)full_handshakes,
+        resumed_handshakes ? resumed_handshake_total_ms / resumed_handshakes : 0, (unsigned long)resumed_handshakes);
+}
+
+static int tls_session_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    bool resuming = cached_session != NULL;
+
+    tls_session_config.timeout_ms = timeout_ms;
+    tls_session_config.client_session = cached_session;
+
+    tls = esp_tls_init();
+
+    if (tls == NULL)
+    {
+        ESP_LOGI(TAG, "tls init failed!");
+        return -1;
+    }
+
+    int64_t handshake_start = esp_timer_get_time();
+
+    // the handshake math is most of the time to a usable socket, don't let dfs stretch it
+    take_sleep_inhibit(SleepInhibit_TlsHandshake);
+
+    int connected = esp_tls_conn_new_sync(host, strlen(host), port, &tls_session_config, tls);
+
+    return_sleep_inhibit(SleepInhibit_TlsHandshake);
+
+    if (connected <= 0)
+    {
+        ESP_LOGI(TAG, "tls connect failed!");
+
+        capture_tls_error(t);
+        esp_tls_conn_destroy(tls);
+        tls = NULL;
+
+        // don't let a session the server refuses break every retry after it
+        if (resuming)
+        {
+            clear_tls_session();
+
+#ifdef TLS_SESSION_RETAIN_IN_RTC
+            rtc_session_length = 0;
+#endif
+        }
+
+        return -1;
+    }
+
+    log_handshake_time(resuming, (esp_timer_get_time() - handshake_start) / 1000);
+
+    save_tls_session();
+
+    return 0;
+}
+
+static int tls_session_poll(esp_transport_handle_t t, int timeout_ms, bool write)
+{
+    int sock = tls_session_get_socket(t);
+
+    if (sock < 0)
+    {
+        return -1;
+    }
+
+    fd_set ready_fds;
+    fd_set error_fds;
+    FD_ZERO(&ready_fds);
+    FD_ZERO(&error_fds);
+    FD_SET(sock, &ready_fds);
+    FD_SET(sock, &error_fds);
+
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000
+    };
+
+    int ret = select(
+        sock + 1,
+        write ? NULL : &ready_fds,
+        write ? &ready_fds : NULL,
+        &error_fds,
+        (timeout_ms < 0) ? NULL : &timeout
+    );
+
+    if (ret > 0 && FD_ISSET(sock, &error_fds))
+    {
+        int sock_errno = 0;
+        socklen_t sock_errno_len = sizeof(sock_errno);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &sock_errno, &sock_errno_len);
+
+        ESP_LOGI(TAG, "tls socket error %d", sock_errno);
+
+        return -1;
+    }
+
+    return ret;
+}
+
+static int tls_session_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    // decrypted bytes waiting in the tls layer are invisible to select
+    if (tls != NULL && esp_tls_get_bytes_avail(tls) > 0)
+    {
+        return 1;
+    }
+
+    return tls_session_poll(t, timeout_ms, false);
+}
+
+static int tls_session_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_session_poll(t, timeout_ms, true);
+}
+
+static int tls_session_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    if (tls == NULL)
+    {
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    int poll = 1;
+
+    if (esp_tls_get_bytes_avail(tls) <= 0)
+    {
+        poll = tls_session_poll(t, timeout_ms, false);
+
+        if (poll < 0)
+        {
+            return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+        }
+        if (poll == 0)
+        {
+            return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+        }
+    }
+
+    int ret = esp_tls_conn_read(tls, buffer, len);
+
+    if (ret < 0)
+    {
+        if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT)
+        {
+            return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+        }
+
+        capture_tls_error(t);
+
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    if (ret == 0)
+    {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+
+    return ret;
+}
+
+static int tls_session_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    if (tls == NULL)
+    {
+        return -1;
+    }
+
+    int poll = tls_session_poll_write(t, timeout_ms);
+
+    if (poll <= 0)
+    {
+        return poll;
+    }
+
+    int ret = esp_tls_conn_write(tls, buffer, len);
+
+    if (ret < 0)
+    {
+        capture_tls_error(t);
+    }
+
+    return ret;
+}
+
+static int tls_session_close(esp_transport_handle_t t)
+{
+    if (tls != NULL)
+    {
+        esp_tls_conn_destroy(tls);
+        tls = NULL;
+    }
+
+    return 0;
+}
+
+static int tls_session_destroy(esp_transport_handle_t t)
+{
+    tls_session_close(t);
+    clear_tls_session();
+
+    return 0;
+}
+
+int tls_session_get_socket(esp_transport_handle_t transport)
+{
+    int sock = -1;
+
+    if (tls != NULL)
+    {
+        esp_tls_get_conn_sockfd(tls, &sock);
+    }
+
+    return sock;
+}
+
+esp_transport_handle_t init_tls_session_transport(const esp_tls_cfg_t *tls_config, const char *path, const char *user_agent)
+{
+    if (ws_transport != NULL)
+    {
+        return ws_transport;
+    }
+
+    ESP_LOGI(TAG, "initializing tls session transport...");
+
+    tls_session_config = *tls_config;
+
+#ifdef TLS_SESSION_RETAIN_IN_RTC
+    restore_tls_session();
+#endif
+
+    tls_transport = esp_transport_init();
+
+    if (tls_transport == NULL)
+    {
+        ESP_LOGI(TAG, "tls transport init failed!");
+        return NULL;
+    }
+
+    esp_transport_set_func(
+        tls_transport,
+        tls_session_connect,
+        tls_session_read,
+        tls_session_write,
+        tls_session_close,
+        tls_session_poll_read,
+        tls_session_poll_write,
+        tls_session_destroy
+    );
+    esp_transport_set_default_port(tls_transport, TLS_SESSION_DEFAULT_PORT);
+
+    ws_transport = esp_transport_ws_init(tls_transport);
+
+    if (ws_transport == NULL)
+    {
+        ESP_LOGI(TAG, "ws transport init failed!");
+
+        esp_transport_destroy(tls_transport);
+        tls_transport = NULL;
+
+        return NULL;
+    }
+
+    esp_transport_ws_config_t ws_config = {
+        .ws_path = path,
+        .user_agent = user_agent
+    };
+    esp_transport_ws_set_config(ws_transport, &ws_config);
+    esp_transport_set_default_port(ws_transport, TLS_SESSION_DEFAULT_PORT);
+
+    return ws_transport;
+}
@@ -0,0 +1,14 @@
+#ifndef TLS_SESSION_H
+#define TLS_SESSION_H
+
+#include "esp_tls.h"
+#include "esp_transport.h"
+
+// wss transport that offers the last tls session back to the server on every connect.
+// it lives for the whole uptime so the session survives socket restarts and light sleep (and deep sleep, through rtc memory)
+esp_transport_handle_t init_tls_session_transport(const esp_tls_cfg_t *tls_config, const char *path, const char *user_agent);
+
+// socket lookup for the websocket client, the tls layer can't report it through esp_transport_get_socket
+int tls_session_get_socket(esp_transport_handle_t transport);
+
+#endif
@@ -21,7 +21,14 @@
 #include "esp_tls_crypto.h"
 #include "esp_system.h"
 #include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
 #include <arpa/inet.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <sys/eventfd.h>
+#else
+#include "esp_vfs_eventfd.h"
+#endif
 
 static const char *TAG = "websocket_client";
 
@@ -106,6 +113,8 @@ typedef struct {
     const char                  *cert_common_name;
     esp_err_t (*crt_bundle_attach)(void *conf);
     esp_transport_handle_t      ext_transport;
+    int                         (*ext_transport_get_socket)(esp_transport_handle_t transport);
+    bool                        event_driven_task;
 } websocket_config_storage_t;
 
 typedef enum {
@@ -143,12 +152,15 @@ struct esp_websocket_client {
     char                        *rx_buffer;
     char                        *tx_buffer;
     int                         buffer_size;
+    bool                        static_buffers;
+    esp_websocket_client_mem_stats_t mem_stats;
     bool                        last_fin;
     ws_transport_opcodes_t      last_opcode;
     int                         payload_len;
     int                         payload_offset;
     esp_transport_keep_alive_t  keep_alive_cfg;
     struct ifreq                *if_name;
+    int                         wake_fd;
 };
 
 static uint64_t _tick_get_ms(void)
@@ -156,23 +168,42 @@ static uint64_t _tick_get_ms(void)
     return esp_timer_get_time() / 1000;
 }
 
+static void esp_websocket_client_wake_task(esp_websocket_client_handle_t client)
+{
+    if (client->wake_fd >= 0) {
+        uint64_t count = 1;
+        write(client->wake_fd, &count, sizeof(count));
+    }
+}
+
 static esp_err_t esp_websocket_new_buf(esp_websocket_client_handle_t client, bool is_tx)
 {
 #ifdef CONFIG_ESP_WS_CLIENT_ENABLE_DYNAMIC_BUFFER
+    if (client->static_buffers) {
+        return ESP_OK;
+    }
     if (is_tx) {
         if (client->tx_buffer) {
             free(client->tx_buffer);
         }
 
         client->tx_buffer = calloc(1, client->buffer_size);
-        ESP_WS_CLIENT_MEM_CHECK(TAG, client->tx_buffer, return ESP_ERR_NO_MEM);
+        client->mem_stats.buffer_allocs++;
+        ESP_WS_CLIENT_MEM_CHECK(TAG, client->tx_buffer, {
+            client->mem_stats.alloc_failures++;
+            return ESP_ERR_NO_MEM;
+        });
     } else {
         if (client->rx_buffer) {
             free(client->rx_buffer);
         }
 
         client->rx_buffer = calloc(1, client->buffer_size);
-        ESP_WS_CLIENT_MEM_CHECK(TAG, client->rx_buffer, return ESP_ERR_NO_MEM);
+        client->mem_stats.buffer_allocs++;
+        ESP_WS_CLIENT_MEM_CHECK(TAG, client->rx_buffer, {
+            client->mem_stats.alloc_failures++;
+            return ESP_ERR_NO_MEM;
+        });
     }
 #endif
     return ESP_OK;
@@ -181,6 +212,9 @@ static esp_err_t esp_websocket_new_buf(esp_websocket_client_handle_t client, boo
 static void esp_websocket_free_buf(esp_websocket_client_handle_t client, bool is_tx)
 {
 #ifdef CONFIG_ESP_WS_CLIENT_ENABLE_DYNAMIC_BUFFER
+    if (client->static_buffers) {
+        return;
+    }
     if (is_tx) {
         if (client->tx_buffer) {
             free(client->tx_buffer);
@@ -249,6 +283,8 @@ static esp_err_t esp_websocket_client_abort_connection(esp_websocket_client_hand
     }
     client->error_handle.error_type = error_type;
     esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_DISCONNECTED, NULL, 0);
+    // the connection may have been aborted from a sending task, make sure the client task notices
+    esp_websocket_client_wake_task(client);
     return ESP_OK;
 }
 
@@ -266,7 +302,9 @@ static esp_err_t esp_websocket_client_error(esp_websocket_client_handle_t client
             free(client->errormsg_buffer);
         }
         client->errormsg_buffer = malloc(needed_size);
+        client->mem_stats.buffer_allocs++;
         if (client->errormsg_buffer == NULL) {
+            client->mem_stats.alloc_failures++;
             client->errormsg_size = 0;
             ESP_LOGE(TAG, "Failed to allocate...");
             return ESP_ERR_NO_MEM;
@@ -443,6 +481,9 @@ static void destroy_and_free_resources(esp_websocket_client_handle_t client)
     if (client->if_name) {
         free(client->if_name);
     }
+    if (client->wake_fd >= 0) {
+        close(client->wake_fd);
+    }
     esp_websocket_client_destroy_config(client);
     if (client->transport_list) {
         esp_transport_list_destroy(client->transport_list);
@@ -451,8 +492,10 @@ static void destroy_and_free_resources(esp_websocket_client_handle_t client)
 #ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
     vSemaphoreDelete(client->tx_lock);
 #endif
-    free(client->tx_buffer);
-    free(client->rx_buffer);
+    if (!client->static_buffers) {
+        free(client->tx_buffer);
+        free(client->rx_buffer);
+    }
     free(client->errormsg_buffer);
     if (client->status_bits) {
         vEventGroupDelete(client->status_bits);
@@ -471,6 +514,7 @@ static esp_err_t stop_wait_task(esp_websocket_client_handle_t client)
     }
 
     client->run = false;
+    esp_websocket_client_wake_task(client);
     xEventGroupWaitBits(client->status_bits, STOPPED_BIT, false, true, portMAX_DELAY);
     client->state = WEBSOCKET_STATE_UNKNOW;
     return ESP_OK;
@@ -598,18 +642,8 @@ static esp_err_t esp_websocket_client_create_transport(esp_websocket_client_hand
     return ESP_OK;
 }
 
-static int esp_websocket_client_send_with_exact_opcode(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const uint8_t *data, int len, TickType_t timeout)
+static int esp_websocket_client_check_send(esp_websocket_client_handle_t client)
 {
-    int ret = -1;
-    int need_write = len;
-    int wlen = 0, widx = 0;
-    bool contained_fin = opcode & WS_TRANSPORT_OPCODES_FIN;
-
-    if (client == NULL || len < 0 || (data == NULL && len > 0)) {
-        ESP_LOGE(TAG, "Invalid arguments");
-        return -1;
-    }
-
     if (!esp_websocket_client_is_connected(client)) {
         ESP_LOGE(TAG, "Websocket client is not connected");
         return -1;
@@ -619,18 +653,64 @@ static int esp_websocket_client_send_with_exact_opcode(esp_websocket_client_hand
         ESP_LOGE(TAG, "Invalid transport");
         return -1;
     }
+    return 0;
+}
 
+static bool esp_websocket_client_lock_tx(esp_websocket_client_handle_t client, TickType_t timeout)
+{
 #ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
     if (xSemaphoreTakeRecursive(client->tx_lock, timeout) != pdPASS) {
-        ESP_LOGE(TAG, "Could not lock ws-client within %" PRIu32 " timeout", timeout);
-        return -1;
-    }
 #else
     if (xSemaphoreTakeRecursive(client->lock, timeout) != pdPASS) {
+#endif
         ESP_LOGE(TAG, "Could not lock ws-client within %" PRIu32 " timeout", timeout);
-        return -1;
+        return false;
     }
+    return true;
+}
+
+static void esp_websocket_client_unlock_tx(esp_websocket_client_handle_t client)
+{
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    xSemaphoreGiveRecursive(client->tx_lock);
+#else
+    xSemaphoreGiveRecursive(client->lock);
 #endif
+    esp_websocket_client_wake_task(client);
+}
+
+static void esp_websocket_client_send_failed(esp_websocket_client_handle_t client, int ret)
+{
+    esp_tls_error_handle_t error_handle = esp_transport_get_error_handle(client->transport);
+    if (error_handle) {
+        esp_websocket_client_error(client, "esp_transport_write() returned %d, transport_error=%s, tls_error_code=%i, tls_flags=%i, errno=%d",
+                                   ret, esp_err_to_name(error_handle->last_error), error_handle->esp_tls_error_code,
+                                   error_handle->esp_tls_flags, errno);
+    } else {
+        esp_websocket_client_error(client, "esp_transport_write() returned %d, errno=%d", ret, errno);
+    }
+    esp_websocket_client_abort_connection(client, WEBSOCKET_ERROR_TYPE_TCP_TRANSPORT);
+}
+
+static int esp_websocket_client_send_with_exact_opcode(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const uint8_t *data, int len, TickType_t timeout)
+{
+    int ret = -1;
+    int need_write = len;
+    int wlen = 0, widx = 0;
+    bool contained_fin = opcode & WS_TRANSPORT_OPCODES_FIN;
+
+    if (client == NULL || len < 0 || (data == NULL && len > 0)) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+
+    if (esp_websocket_client_check_send(client) != 0) {
+        return -1;
+    }
+
+    if (!esp_websocket_client_lock_tx(client, timeout)) {
+        return -1;
+    }
 
     if (esp_websocket_new_buf(client, true) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to setup tx buffer");
@@ -651,15 +731,7 @@ static int esp_websocket_client_send_with_exact_opcode(esp_websocket_client_hand
         if (wlen < 0 || (wlen == 0 && need_write != 0)) {
             ret = wlen;
             esp_websocket_free_buf(client, true);
-            esp_tls_error_handle_t error_handle = esp_transport_get_error_handle(client->transport);
-            if (error_handle) {
-                esp_websocket_client_error(client, "esp_transport_write() returned %d, transport_error=%s, tls_error_code=%i, tls_flags=%i, errno=%d",
-                                           ret, esp_err_to_name(error_handle->last_error), error_handle->esp_tls_error_code,
-                                           error_handle->esp_tls_flags, errno);
-            } else {
-                esp_websocket_client_error(client, "esp_transport_write() returned %d, errno=%d", ret, errno);
-            }
-            esp_websocket_client_abort_connection(client, WEBSOCKET_ERROR_TYPE_TCP_TRANSPORT);
+            esp_websocket_client_send_failed(client, ret);
             goto unlock_and_return;
         }
         opcode = 0;
@@ -670,11 +742,7 @@ static int esp_websocket_client_send_with_exact_opcode(esp_websocket_client_hand
     ret = widx;
 
 unlock_and_return:
-#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
-    xSemaphoreGiveRecursive(client->tx_lock);
-#else
-    xSemaphoreGiveRecursive(client->lock);
-#endif
+    esp_websocket_client_unlock_tx(client);
     return ret;
 }
 
@@ -682,6 +750,7 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
 {
     esp_websocket_client_handle_t client = calloc(1, sizeof(struct esp_websocket_client));
     ESP_WS_CLIENT_MEM_CHECK(TAG, client, return NULL);
+    client->wake_fd = -1;
 
     esp_event_loop_args_t event_args = {
         .queue_size = WEBSOCKET_EVENT_QUEUE_SIZE,
@@ -753,6 +822,24 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
     client->config->cert_common_name = config->cert_common_name;
     client->config->crt_bundle_attach = config->crt_bundle_attach;
     client->config->ext_transport = config->ext_transport;
+    client->config->ext_transport_get_socket = config->ext_transport_get_socket;
+    client->config->event_driven_task = config->event_driven_task;
+
+    if (config->event_driven_task) {
+#if !CONFIG_IDF_TARGET_LINUX
+        esp_vfs_eventfd_config_t eventfd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+        esp_err_t eventfd_err = esp_vfs_eventfd_register(&eventfd_config);
+        if (eventfd_err != ESP_OK && eventfd_err != ESP_ERR_INVALID_STATE) { // already registered by an earlier client
+            ESP_LOGE(TAG, "Failed to register eventfd: %s", esp_err_to_name(eventfd_err));
+            goto _websocket_init_fail;
+        }
+#endif
+        client->wake_fd = eventfd(0, 0);
+        if (client->wake_fd < 0) {
+            ESP_LOGE(TAG, "Failed to create wake eventfd, errno=%d", errno);
+            goto _websocket_init_fail;
+        }
+    }
 
     if (config->uri) {
         if (esp_websocket_client_set_uri(client, config->uri) != ESP_OK) {
@@ -783,15 +870,26 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
     }
     client->errormsg_buffer = NULL;
     client->errormsg_size = 0;
+    if (config->rx_buffer || config->tx_buffer) {
+        if (!config->rx_buffer || !config->tx_buffer || config->buffer_size <= 0) {
+            ESP_LOGE(TAG, "Static buffers need both rx_buffer and tx_buffer of buffer_size bytes");
+            goto _websocket_init_fail;
+        }
+        client->rx_buffer = config->rx_buffer;
+        client->tx_buffer = config->tx_buffer;
+        client->static_buffers = true;
+    }
 #ifndef CONFIG_ESP_WS_CLIENT_ENABLE_DYNAMIC_BUFFER
-    client->rx_buffer = malloc(buffer_size);
-    ESP_WS_CLIENT_MEM_CHECK(TAG, client->rx_buffer, {
-        goto _websocket_init_fail;
-    });
-    client->tx_buffer = malloc(buffer_size);
-    ESP_WS_CLIENT_MEM_CHECK(TAG, client->tx_buffer, {
-        goto _websocket_init_fail;
-    });
+    else {
+        client->rx_buffer = malloc(buffer_size);
+        ESP_WS_CLIENT_MEM_CHECK(TAG, client->rx_buffer, {
+            goto _websocket_init_fail;
+        });
+        client->tx_buffer = malloc(buffer_size);
+        ESP_WS_CLIENT_MEM_CHECK(TAG, client->tx_buffer, {
+            goto _websocket_init_fail;
+        });
+    }
 #endif
     client->status_bits = xEventGroupCreate();
     ESP_WS_CLIENT_MEM_CHECK(TAG, client->status_bits, {
@@ -1016,6 +1114,83 @@ static esp_err_t esp_websocket_client_recv(esp_websocket_client_handle_t client)
 
 static int esp_websocket_client_send_close(esp_websocket_client_handle_t client, int code, const char *additional_data, int total_len, TickType_t timeout);
 
+static int esp_websocket_client_next_timeout_ms(esp_websocket_client_handle_t client)
+{
+    uint64_t now = _tick_get_ms();
+    uint64_t deadline;
+
+    if (client->state == WEBSOCKET_STATE_WAIT_TIMEOUT) {
+        deadline = client->reconnect_tick_ms + client->wait_timeout_ms;
+    } else if ((CLOSE_FRAME_SENT_BIT & xEventGroupGetBits(client->status_bits)) == 0) {
+        deadline = client->ping_tick_ms + client->config->ping_interval_sec * 1000;
+        if (client->wait_for_pong_resp && client->config->pingpong_timeout_sec) {
+            uint64_t pong_deadline = client->pingpong_tick_ms + client->config->pingpong_timeout_sec * 1000;
+            if (pong_deadline < deadline) {
+                deadline = pong_deadline;
+            }
+        }
+    } else {
+        // closing: only the server's close frame or a stop request moves the client on
+        return client->config->network_timeout_ms;
+    }
+
+    // the task loop checks deadlines with a strict '>', so wake just after them
+    deadline += 1;
+    return (deadline > now) ? (int)(deadline - now) : 0;
+}
+
+/**
+ * Blocks until the socket is readable, the task is woken through wake_fd or the next deadline is due.
+ * Returns >0 if there is data to read, 0 if the task should just re-run its state machine, <0 on socket errors.
+ */
+static int esp_websocket_client_wait_for_event(esp_websocket_client_handle_t client)
+{
+    int sock = -1;
+
+    if (client->state == WEBSOCKET_STATE_CONNECTED) {
+        // TLS and ws framing may already hold buffered bytes that select() cannot see
+        int pending = esp_transport_poll_read(client->transport, 0);
+        if (pending != 0) {
+            return pending;
+        }
+        if (client->config->ext_transport_get_socket) {
+            sock = client->config->ext_transport_get_socket(client->transport);
+        } else {
+            sock = esp_transport_get_socket(client->transport);
+        }
+        if (sock < 0) {
+            // nothing to select() on, fall back to polling the transport
+            int timeout_ms = esp_websocket_client_next_timeout_ms(client);
+            return esp_transport_poll_read(client->transport, (timeout_ms < 1000) ? timeout_ms : 1000);
+        }
+    }
+
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(client->wake_fd, &read_fds);
+    if (sock >= 0) {
+        FD_SET(sock, &read_fds);
+    }
+
+    int timeout_ms = esp_websocket_client_next_timeout_ms(client);
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+
+    int ret = select(((sock > client->wake_fd) ? sock : client->wake_fd) + 1, &read_fds, NULL, NULL, &timeout);
+    if (ret < 0) {
+        return (errno == EINTR || sock < 0) ? 0 : -1;
+    }
+
+    if (FD_ISSET(client->wake_fd, &read_fds)) {
+        uint64_t count;
+        read(client->wake_fd, &count, sizeof(count));
+    }
+
+    return (sock >= 0 && FD_ISSET(sock, &read_fds)) ? 1 : 0;
+}
+
 static void esp_websocket_client_task(void *pv)
 {
     const int lock_timeout = portMAX_DELAY;
@@ -1148,7 +1323,11 @@ static void esp_websocket_client_task(void *pv)
         }
         xSemaphoreGiveRecursive(client->lock);
         if (WEBSOCKET_STATE_CONNECTED == client->state) {
-            read_select = esp_transport_poll_read(client->transport, 1000); //Poll every 1000ms
+            if (client->config->event_driven_task) {
+                read_select = esp_websocket_client_wait_for_event(client);
+            } else {
+                read_select = esp_transport_poll_read(client->transport, 1000); //Poll every 1000ms
+            }
             if (read_select < 0) {
                 esp_tls_error_handle_t error_handle = esp_transport_get_error_handle(client->transport);
                 if (error_handle) {
@@ -1171,7 +1350,11 @@ static void esp_websocket_client_task(void *pv)
             }
         } else if (WEBSOCKET_STATE_WAIT_TIMEOUT == client->state) {
             // waiting for reconnecting...
-            vTaskDelay(client->wait_timeout_ms / 2 / portTICK_PERIOD_MS);
+            if (client->config->event_driven_task) {
+                esp_websocket_client_wait_for_event(client);
+            } else {
+                vTaskDelay(client->wait_timeout_ms / 2 / portTICK_PERIOD_MS);
+            }
         } else if (WEBSOCKET_STATE_CLOSING == client->state &&
                    (CLOSE_FRAME_SENT_BIT & xEventGroupGetBits(client->status_bits))) {
             ESP_LOGD(TAG, " Waiting for TCP connection to be closed by the server");
@@ -1295,6 +1478,7 @@ static esp_err_t esp_websocket_client_close_with_optional_body(esp_websocket_cli
 
     // Set closing bit to prevent from sending PING frames while connected
     xEventGroupSetBits(client->status_bits, CLOSE_FRAME_SENT_BIT);
+    esp_websocket_client_wake_task(client);
 
     if (STOPPED_BIT & xEventGroupWaitBits(client->status_bits, STOPPED_BIT, false, true, timeout)) {
         return ESP_OK;
@@ -1352,6 +1536,63 @@ int esp_websocket_client_send_with_opcode(esp_websocket_client_handle_t client,
     return esp_websocket_client_send_with_exact_opcode(client, opcode | WS_TRANSPORT_OPCODES_FIN, data, len, timeout);
 }
 
+int esp_websocket_client_send_iov(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const esp_websocket_iov_t *iov, int iovcnt, TickType_t timeout)
+{
+    int ret = -1;
+    int sent = 0;
+
+    if (client == NULL || iov == NULL || iovcnt < 1) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].len < 0 || (iov[i].data == NULL && iov[i].len > 0)) {
+            ESP_LOGE(TAG, "Invalid arguments");
+            return -1;
+        }
+    }
+
+    if (esp_websocket_client_check_send(client) != 0) {
+        return -1;
+    }
+
+    if (!esp_websocket_client_lock_tx(client, timeout)) {
+        return -1;
+    }
+
+    for (int i = 0; i < iovcnt; i++) {
+        ws_transport_opcodes_t frame_opcode = (i == 0) ? opcode : WS_TRANSPORT_OPCODES_CONT;
+        if (i == iovcnt - 1) {
+            frame_opcode |= WS_TRANSPORT_OPCODES_FIN;
+        }
+        // the transport masks the payload in place and unmasks it again once the frame is written,
+        // so the caller's buffer is written as-is without going through tx_buffer. a failed write can leave it masked
+        int wlen = esp_transport_ws_send_raw(client->transport, frame_opcode, (char *)iov[i].data, iov[i].len,
+                                             (timeout == portMAX_DELAY) ? -1 : timeout * portTICK_PERIOD_MS);
+        if (wlen != iov[i].len) {
+            // a short write leaves a frame with a header promising more payload, the stream cannot be recovered
+            ret = (wlen < 0) ? wlen : -1;
+            esp_websocket_client_send_failed(client, wlen);
+            goto unlock_and_return;
+        }
+        sent += wlen;
+    }
+    ret = sent;
+
+unlock_and_return:
+    esp_websocket_client_unlock_tx(client);
+    return ret;
+}
+
+int esp_websocket_client_send_text_inplace(esp_websocket_client_handle_t client, char *data, int len, TickType_t timeout)
+{
+    esp_websocket_iov_t iov = {
+        .data = (uint8_t *)data,
+        .len = len,
+    };
+    return esp_websocket_client_send_iov(client, WS_TRANSPORT_OPCODES_TEXT, &iov, 1, timeout);
+}
+
 bool esp_websocket_client_is_connected(esp_websocket_client_handle_t client)
 {
     if (client == NULL) {
@@ -1388,10 +1629,21 @@ esp_err_t esp_websocket_client_set_ping_interval_sec(esp_websocket_client_handle
     }
 
     client->config->ping_interval_sec = ping_interval_sec == 0 ? WEBSOCKET_PING_INTERVAL_SEC : ping_interval_sec;
+    esp_websocket_client_wake_task(client);
 
     return ESP_OK;
 }
 
+esp_err_t esp_websocket_client_get_mem_stats(esp_websocket_client_handle_t client, esp_websocket_client_mem_stats_t *stats)
+{
+    if (client == NULL || stats == NULL) {
+        ESP_LOGW(TAG, "Client or stats was NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stats = client->mem_stats;
+    return ESP_OK;
+}
+
 int esp_websocket_client_get_reconnect_timeout(esp_websocket_client_handle_t client)
 {
     if (client == NULL) {
@@ -1425,6 +1677,7 @@ esp_err_t esp_websocket_client_set_reconnect_timeout(esp_websocket_client_handle
     }
 
     client->wait_timeout_ms = reconnect_timeout_ms;
+    esp_websocket_client_wake_task(client);
 
     return ESP_OK;
 }
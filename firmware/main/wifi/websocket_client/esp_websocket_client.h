@@ -108,6 +108,8 @@ typedef struct {
     const char                 *task_name;                  /*!< Websocket task name */
     int                         task_stack;                 /*!< Websocket task stack */
     int                         buffer_size;                /*!< Websocket buffer size */
+    char                        *rx_buffer;                 /*!< Caller-owned storage of buffer_size bytes for received data; set together with tx_buffer so the client never allocates its buffers */
+    char                        *tx_buffer;                 /*!< Caller-owned storage of buffer_size bytes for sent data; must outlive the client */
     const char                  *cert_pem;                  /*!< Pointer to certificate data in PEM or DER format for server verify (with SSL), default is NULL, not required to verify the server. PEM-format must have a terminating NULL-character. DER-format requires the length to be passed in cert_len. */
     size_t                      cert_len;                   /*!< Length of the buffer pointed to by cert_pem. May be 0 for null-terminated pem */
     const char                  *client_cert;               /*!< Pointer to certificate data in PEM or DER format for SSL mutual authentication, default is NULL, not required if mutual authentication is not needed. If it is not NULL, also `client_key` or `client_ds_data` (if supported) has to be provided. PEM-format must have a terminating NULL-character. DER-format requires the length to be passed in client_cert_len. */
@@ -136,8 +138,26 @@ typedef struct {
     size_t                      ping_interval_sec;          /*!< Websocket ping interval, defaults to 10 seconds if not set */
     struct ifreq                *if_name;                   /*!< The name of interface for data to go through. Use the default interface without setting */
     esp_transport_handle_t      ext_transport;              /*!< External WebSocket tcp_transport handle to the client; or if null, the client will create its own transport handle. */
+    int                         (*ext_transport_get_socket)(esp_transport_handle_t transport); /*!< Socket lookup for an ext_transport whose base transport can't report it through esp_transport_get_socket(), used by event_driven_task */
+    bool                        event_driven_task;          /*!< Block the client task until the socket is readable, a frame was sent, a ping/pong/reconnect deadline is due or a stop was requested, instead of polling the socket every second */
 } esp_websocket_client_config_t;
 
+/**
+ * @brief Heap usage counters of the client buffers
+ */
+typedef struct {
+    uint32_t buffer_allocs;                                 /*!< Heap allocations of rx, tx and error message buffers made after init */
+    uint32_t alloc_failures;                                /*!< Number of those allocations that failed */
+} esp_websocket_client_mem_stats_t;
+
+/**
+ * @brief Payload segment for the zero-copy send API
+ */
+typedef struct {
+    uint8_t *data;                                          /*!< Caller-owned payload, masked in place while it is written */
+    int len;                                                /*!< Payload length */
+} esp_websocket_iov_t;
+
 /**
  * @brief      Start a Websocket session
  *             This function must be the first function to call,
@@ -359,6 +379,46 @@ int esp_websocket_client_send_fin(esp_websocket_client_handle_t client, TickType
  */
 int esp_websocket_client_send_with_opcode(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const uint8_t *data, int len, TickType_t timeout);
 
+/**
+ * @brief      Write a message from caller-owned buffers without copying them (zero-copy send)
+ *
+ * @param[in]  client  The client
+ * @param[in]  opcode  The opcode of the message (e.g. WS_TRANSPORT_OPCODES_TEXT)
+ * @param[in]  iov     Array of payload segments
+ * @param[in]  iovcnt  Number of segments, at least 1
+ * @param[in]  timeout Write data timeout in RTOS ticks
+ *
+ *  Notes:
+ *  - Each segment is written as its own frame straight from the caller's buffer: the first frame carries
+ *    `opcode`, the following ones are continuation frames and the last one has the FIN bit set
+ *  - The payload is masked in place while it is written, so segments must point to writable RAM (not flash/rodata)
+ *    and must not be touched by other tasks during the call. It is restored once a frame is written, but a failed
+ *    write can leave it masked: rebuild the payload before sending it again
+ *  - No tx buffer is allocated, unlike `esp_websocket_client_send_with_opcode(...)`
+ *
+ * @return
+ *     - Number of payload bytes sent
+ *     - (-1) if any errors
+ */
+int esp_websocket_client_send_iov(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const esp_websocket_iov_t *iov, int iovcnt, TickType_t timeout);
+
+/**
+ * @brief      Write textual data from a writable caller-owned buffer without copying it (data send with WS OPCODE=01, i.e. text)
+ *
+ *  Notes:
+ *  - See `esp_websocket_client_send_iov(...)`, the buffer is masked in place for the duration of the call
+ *
+ * @param[in]  client  The client
+ * @param[in]  data    The data, in writable RAM
+ * @param[in]  len     The length
+ * @param[in]  timeout Write data timeout in RTOS ticks
+ *
+ * @return
+ *     - Number of data was sent
+ *     - (-1) if any errors
+ */
+int esp_websocket_client_send_text_inplace(esp_websocket_client_handle_t client, char *data, int len, TickType_t timeout);
+
 /**
  * @brief      Close the WebSocket connection in a clean way
  *
@@ -425,6 +485,16 @@ size_t esp_websocket_client_get_ping_interval_sec(esp_websocket_client_handle_t
  */
 esp_err_t esp_websocket_client_set_ping_interval_sec(esp_websocket_client_handle_t client, size_t ping_interval_sec);
 
+/**
+ * @brief      Get the heap usage counters of the client buffers.
+ *
+ * @param[in]  client  The client
+ * @param[out] stats   Counters since init
+ *
+ * @return     esp_err_t
+ */
+esp_err_t esp_websocket_client_get_mem_stats(esp_websocket_client_handle_t client, esp_websocket_client_mem_stats_t *stats);
+
 /**
  * @brief      Get the next reconnect timeout for client. Returns -1 when client is not initialized or automatic reconnect is disabled.
  *
@@ -4,8 +4,11 @@
 #include "main.h"
 #include "socket.h"
 #include "status/status.h"
+#include "boot_profile/boot_profile.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 
 #include "freertos/task.h"
@@ -15,6 +18,10 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_eap_client.h"
+#include "esp_mac.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "nvs.h"
 
 // TODO: pull from .env
 // #define WIFI_USE_WPA2_PSK
@@ -27,10 +34,167 @@
 #define WIFI_EAP_IDENTITY   "test"
 #define WIFI_EAP_DOMAIN     "test"
 
+// connected sleep: the station stays associated through light sleep and only wakes the radio for every
+// WIFI_LISTEN_INTERVAL-th beacon. sending (a ring) wakes it right away, this only delays what the server sends us.
+// WIFI_PS_MIN_MODEM wakes for every dtim instead, quicker replies for more current
+#define WIFI_POWER_SAVE             WIFI_PS_MAX_MODEM
+#define WIFI_LISTEN_INTERVAL        3
+
+#define WIFI_JOIN_CACHE_MAGIC       0xd00be11a
+#define WIFI_NVS_NAMESPACE          "wifi"
+#define WIFI_NVS_JOIN_CACHE_KEY     "join_cache"
+
 static const char *TAG = "wifi";
 
-// ok so turns out refusing to sleep without a wifi connection is a bad idea
-// static bool took_sleep_inhibit;
+// the access point we last got an ip from, so the next join can skip the scan
+struct WifiJoinCache
+{
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+};
+
+// rtc memory survives sleep, nvs survives power loss
+static RTC_DATA_ATTR struct WifiJoinCache join_cache;
+
+static wifi_config_t wifi_config;
+
+static bool directed_join;
+static int64_t join_start_time;
+static int64_t join_associated_time;
+
+// ok so turns out refusing to sleep without a wifi connection is a bad idea, wifi takes no sleep inhibit
+
+static void load_join_cache()
+{
+    if (join_cache.magic == WIFI_JOIN_CACHE_MAGIC)
+    {
+        return;
+    }
+
+    nvs_handle_t nvs;
+
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return;
+    }
+
+    size_t size = sizeof(join_cache);
+
+    if (nvs_get_blob(nvs, WIFI_NVS_JOIN_CACHE_KEY, &join_cache, &size) != ESP_OK || size != sizeof(join_cache))
+    {
+        join_cache.magic = 0;
+    }
+
+    nvs_close(nvs);
+}
+
+static void save_join_cache()
+{
+    wifi_ap_record_t ap_info;
+
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+    {
+        return;
+    }
+
+    // don't wear the flash out rewriting the same access point every wake
+    if (join_cache.magic == WIFI_JOIN_CACHE_MAGIC
+        && join_cache.channel == ap_info.primary
+        && memcmp(join_cache.bssid, ap_info.bssid, sizeof(join_cache.bssid)) == 0)
+    {
+        return;
+    }
+
+    join_cache.magic = WIFI_JOIN_CACHE_MAGIC;
+    join_cache.channel = ap_info.primary;
+    memcpy(join_cache.bssid, ap_info.bssid, sizeof(join_cache.bssid));
+
+    ESP_LOGI(TAG, "caching access point " MACSTR " on channel %d", MAC2STR(join_cache.bssid), join_cache.channel);
+
+    nvs_handle_t nvs;
+
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        return;
+    }
+
+    if (nvs_set_blob(nvs, WIFI_NVS_JOIN_CACHE_KEY, &join_cache, sizeof(join_cache)) == ESP_OK)
+    {
+        nvs_commit(nvs);
+    }
+
+    nvs_close(nvs);
+}
+
+static void forget_join_cache()
+{
+    join_cache.magic = 0;
+
+    nvs_handle_t nvs;
+
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        return;
+    }
+
+    if (nvs_erase_key(nvs, WIFI_NVS_JOIN_CACHE_KEY) == ESP_OK)
+    {
+        nvs_commit(nvs);
+    }
+
+    nvs_close(nvs);
+}
+
+static void connect_wifi()
+{
+    load_join_cache();
+
+    directed_join = join_cache.magic == WIFI_JOIN_CACHE_MAGIC;
+
+    if (directed_join)
+    {
+        ESP_LOGI(TAG, "joining cached access point " MACSTR " on channel %d...", MAC2STR(join_cache.bssid), join_cache.channel);
+
+        wifi_config.sta.bssid_set = true;
+        wifi_config.sta.channel = join_cache.channel;
+        memcpy(wifi_config.sta.bssid, join_cache.bssid, sizeof(join_cache.bssid));
+    }
+    else
+    {
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+    }
+
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+    join_start_time = esp_timer_get_time();
+    join_associated_time = 0;
+
+    esp_wifi_connect();
+}
+
+static void log_join_time()
+{
+    if (join_start_time == 0 || join_associated_time == 0)
+    {
+        return;
+    }
+
+    int64_t got_ip_time = esp_timer_get_time();
+
+    // scan, auth and the eap exchange all happen inside the driver before it reports the association
+    ESP_LOGI(
+        TAG,
+        "%s join took %" PRId64 " ms: scan/auth/eap %" PRId64 " ms, dhcp %" PRId64 " ms",
+        directed_join ? "directed" : "full",
+        (got_ip_time - join_start_time) / 1000,
+        (join_associated_time - join_start_time) / 1000,
+        (got_ip_time - join_associated_time) / 1000
+    );
+
+    join_start_time = 0;
+}
 
 static void wifi_event_handler(
     void* arg,
@@ -43,29 +207,34 @@ static void wifi_event_handler(
     {
         if (event_id == WIFI_EVENT_STA_START)
         {
-            esp_wifi_connect();
+            connect_wifi();
         }
         else if (event_id == WIFI_EVENT_STA_CONNECTED)
         {
+            join_associated_time = esp_timer_get_time();
+
             ESP_LOGI(TAG, "connected to access point, waiting for ip...");
         }
         else if (event_id == WIFI_EVENT_STA_DISCONNECTED)
         {
             ESP_LOGI(TAG, "failed to connect to an access point");
 
-            // if (!took_sleep_inhibit)
-            // {
-            //     take_sleep_inhibit();
-            //     took_sleep_inhibit = true;
-            // }
-
             stop_socket();
 
             update_wifi_status(WifiStatus_Connecting);
 
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
+            if (directed_join)
+            {
+                ESP_LOGI(TAG, "cached access point didn't work, falling back to a full join...");
 
-            esp_wifi_connect();
+                forget_join_cache();
+            }
+            else
+            {
+                vTaskDelay(1000 / portTICK_PERIOD_MS);
+            }
+
+            connect_wifi();
 
             ESP_LOGI(TAG, "retrying connection...");
         }
@@ -78,11 +247,11 @@ static void wifi_event_handler(
 
             ESP_LOGI(TAG, "connected to access point, got ip: " IPSTR, IP2STR(&event->ip_info.ip));
 
-            // if (took_sleep_inhibit)
-            // {
-            //     return_sleep_inhibit();
-            //     took_sleep_inhibit = false;
-            // }
+            log_join_time();
+            save_join_cache();
+
+            // the join worked, later disconnects aren't the cache's fault
+            directed_join = false;
 
             start_socket();
 
@@ -92,12 +261,6 @@ static void wifi_event_handler(
         {
             ESP_LOGI(TAG, "connected to access point, lost ip");
 
-            // if (!took_sleep_inhibit)
-            // {
-            //     take_sleep_inhibit();
-            //     took_sleep_inhibit = true;
-            // }
-
             stop_socket();
 
             update_wifi_status(WifiStatus_Connecting);
@@ -107,6 +270,8 @@ static void wifi_event_handler(
 
 void start_wifi()
 {
+    boot_phase_begin(BootPhase_WifiDriver);
+
     init_socket_state();
 
     ESP_LOGI(TAG, "initializing netif...");
@@ -122,10 +287,18 @@ void start_wifi()
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
+    boot_phase_end(BootPhase_WifiDriver);
+
+    // the event handler publishes its state through status
+    wait_for_status_startup();
+
     ESP_LOGI(TAG, "initializing event handlers...");
 
+    boot_phase_begin(BootPhase_WifiConfig);
+
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
+    esp_event_handler_instance_t instance_lost_ip;
     ESP_ERROR_CHECK(
         esp_event_handler_instance_register(
             WIFI_EVENT,
@@ -144,17 +317,27 @@ void start_wifi()
             &instance_got_ip
         )
     );
+    ESP_ERROR_CHECK(
+        esp_event_handler_instance_register(
+            IP_EVENT,
+            IP_EVENT_STA_LOST_IP,
+            &wifi_event_handler,
+            NULL,
+            &instance_lost_ip
+        )
+    );
 
     ESP_LOGI(TAG, "setting wifi config...");
 
     #ifdef WIFI_USE_WPA2_PSK
     ESP_LOGI(TAG, "using PSK...");
 
-    wifi_config_t wifi_config = {
+    wifi_config = (wifi_config_t) {
         .sta = {
             .ssid = WIFI_SSID,
             .password = WIFI_PASS,
             .threshold.authmode = WIFI_USE_WPA2_PSK,
+            .listen_interval = WIFI_LISTEN_INTERVAL,
         },
     };
 
@@ -166,9 +349,10 @@ void start_wifi()
     ESP_LOGI(TAG, "using WPA2 Enterprise with PEAP...");
 
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
-    wifi_config_t wifi_config = {
+    wifi_config = (wifi_config_t) {
         .sta = {
             .ssid = WIFI_SSID,
+            .listen_interval = WIFI_LISTEN_INTERVAL,
         },
     };
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
@@ -182,28 +366,28 @@ void start_wifi()
     ESP_ERROR_CHECK(esp_wifi_sta_enterprise_enable());
     #endif
 
-    ESP_LOGI(TAG, "starting wifi...");
+    boot_phase_end(BootPhase_WifiConfig);
 
-    // took_sleep_inhibit = true;
+    ESP_LOGI(TAG, "starting wifi...");
 
-    // take_sleep_inhibit();
+    boot_phase_begin(BootPhase_WifiStart);
 
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
-    // i give up on this for now, it breaks wifi completely
-    // esp_sleep_enable_wifi_beacon_wakeup();
+    // with power management on, the driver arms its own beacon wakeup for every automatic light sleep,
+    // there's no wifi wakeup to enable by hand
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_POWER_SAVE));
+
+    boot_phase_end(BootPhase_WifiStart);
+
+    ESP_LOGI(TAG, "power save: %s modem, listen interval %d beacons", (WIFI_POWER_SAVE == WIFI_PS_MAX_MODEM) ? "max" : "min", WIFI_LISTEN_INTERVAL);
 
     ESP_LOGI(TAG, "initialization finished");
 }
 
-void prepare_wifi_for_sleep()
+void prepare_wifi_for_deep_sleep()
 {
+    // close the socket properly so the server doesn't wait on a dead connection, the tls session stays cached in rtc memory
     stop_socket();
     esp_wifi_stop();
 }
-
-void wake_wifi_from_sleep()
-{
-    esp_wifi_start();
-}
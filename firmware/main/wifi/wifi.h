@@ -5,7 +5,6 @@
 
 void start_wifi();
 
-void prepare_wifi_for_sleep();
-void wake_wifi_from_sleep();
+void prepare_wifi_for_deep_sleep();
 
 #endif